@@ -46,9 +46,10 @@ see https://www.gnu.org/licenses/.  */
 #endif
 
 #if defined(_WIN32) && (defined(__GNUC__) && __GNUC_VERSION__ < 40800)
-  typedef unsigned long int pthread_t;
+# define GET_STR_SERIAL 1
 #else
 # include <pthread.h>
+# include <unistd.h>
 #endif
 
 /* Conversion of U {up,un} to a string in base b.  Internally, we convert to
@@ -80,6 +81,11 @@ see https://www.gnu.org/licenses/.  */
   2. Store the powers of (C) in normalized form, with the normalization count.
      Quotients will usually need to be left-shifted before each divide, and
      remainders will either need to be left-shifted of right-shifted.
+     Not done here: mpn_tdiv_qr is the only division of the public interface,
+     and given a normalized divisor it still copies the dividend and the
+     remainder, so shifting them ourselves saves nothing; divisions of 18
+     to 10000 limbs timed the same either way.  The large divisions go to
+     get_str_tdiv_qr, which does not need normalized powers.
   3. In the code for developing digits from a single limb, we could avoid using
      a full umul_ppmm except for the first (or first few) digits, provided base
      is even.  Subsequent digits can be developed using plain multiplication.
@@ -93,7 +99,10 @@ see https://www.gnu.org/licenses/.  */
   5. Completely avoid division.  Compute the inverses of the powers now in
      powtab instead of the actual powers.
   6. Decrease powtab allocation for even bases.  E.g. for base 10 we could save
-     about 30% (1-log(5)/log(10)).
+     about 30% (1-log(5)/log(10)).  This is what the shift field of the powers
+     does: the low zero limbs of 10^k = 5^k 2^k are not stored, so a power
+     keeps its odd part times less than a limb of twos, the squarings work on
+     that, and the divisions leave the low limbs of the dividend alone.
 
   Basic structure of (C):
     mpn_get_str:
@@ -152,14 +161,169 @@ see https://www.gnu.org/licenses/.  */
 #endif
 
 
+/* Base 10 digits of whole limbs with SIMD.  Each limb below 10^19 left by
+   mpn_sb_get_str is cut in three groups of 8 digits, the first one padded
+   with zeros, and the groups are split into digits 4, 2 and 1 at a time in
+   vector lanes, using multiply-high by reciprocals of 10^4, 10^2 and 10.
+   The kernel is picked at run time from the CPU, the plain loop in
+   mpn_sb_get_str remains the fallback.  Define GET_STR_NO_SIMD to leave it
+   out.  */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))	\
+  && GMP_LIMB_BITS == 64 && GMP_NAIL_BITS == 0				\
+  && (__GNUC__ >= 6 || defined(__clang__)) && ! defined(GET_STR_NO_SIMD)
+#define GET_STR_SIMD 1
+#include <immintrin.h>
+
+typedef void (*get_str_digits_t) (unsigned char *, mp_srcptr, size_t);
+
+#define GET_STR_SIMD_BLOCK  8		/* limbs */
+
+/* Put in g[3i..3i+2] the groups of 8 digits of cp[i], for i < n, and zero
+   the rest of the block.  */
+static void
+get_str_groups_10 (unsigned int *g, mp_srcptr cp, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      mp_limb_t lo = cp[i] % CNST_LIMB(10000000000000000);
+      g[3 * i]     = cp[i] / CNST_LIMB(10000000000000000);
+      g[3 * i + 1] = lo / 100000000;
+      g[3 * i + 2] = lo % 100000000;
+    }
+  for (i = 3 * n; i < 3 * GET_STR_SIMD_BLOCK; i++)
+    g[i] = 0;
+}
+
+/* The 32 digits of 4 groups of 8.  */
+__attribute__((target("avx2")))
+static __m256i
+get_str_digits_avx2 (__m128i x4)
+{
+  __m256i x, q, v, t, w, d;
+
+  x = _mm256_cvtepu32_epi64 (x4);
+  q = _mm256_srli_epi64 (_mm256_mul_epu32 (x, _mm256_set1_epi64x (0xd1b71759)), 45);
+  v = _mm256_sub_epi64 (x, _mm256_mul_epu32 (q, _mm256_set1_epi64x (10000)));
+  v = _mm256_or_si256 (q, _mm256_slli_epi64 (v, 32));
+  t = _mm256_srli_epi16 (_mm256_mulhi_epu16 (v, _mm256_set1_epi16 (5243)), 3);
+  w = _mm256_sub_epi16 (v, _mm256_mullo_epi16 (t, _mm256_set1_epi16 (100)));
+  w = _mm256_or_si256 (t, _mm256_slli_epi32 (w, 16));
+  d = _mm256_mulhi_epu16 (w, _mm256_set1_epi16 (6554));
+  w = _mm256_sub_epi16 (w, _mm256_mullo_epi16 (d, _mm256_set1_epi16 (10)));
+  return _mm256_or_si256 (d, _mm256_slli_epi16 (w, 8));
+}
+
+/* The 64 digits of 8 groups of 8.  The zero-masked forms with all lanes
+   set are the plain operations; the plain intrinsics of the AVX-512F header
+   start from an undefined vector, which g++ warns about.  */
+__attribute__((target("avx512f,avx512bw")))
+static __m512i
+get_str_digits_avx512 (__m256i x8)
+{
+  const __mmask8 all8 = 0xff;
+  const __mmask16 all16 = 0xffff;
+  __m512i x, q, v, t, w, d;
+
+  x = _mm512_maskz_cvtepu32_epi64 (all8, x8);
+  q = _mm512_maskz_srli_epi64 (all8, _mm512_maskz_mul_epu32 (all8, x, _mm512_set1_epi64 (0xd1b71759)), 45);
+  v = _mm512_sub_epi64 (x, _mm512_maskz_mul_epu32 (all8, q, _mm512_set1_epi64 (10000)));
+  v = _mm512_or_si512 (q, _mm512_maskz_slli_epi64 (all8, v, 32));
+  t = _mm512_srli_epi16 (_mm512_mulhi_epu16 (v, _mm512_set1_epi16 (5243)), 3);
+  w = _mm512_sub_epi16 (v, _mm512_mullo_epi16 (t, _mm512_set1_epi16 (100)));
+  w = _mm512_or_si512 (t, _mm512_maskz_slli_epi32 (all16, w, 16));
+  d = _mm512_mulhi_epu16 (w, _mm512_set1_epi16 (6554));
+  w = _mm512_sub_epi16 (w, _mm512_mullo_epi16 (d, _mm512_set1_epi16 (10)));
+  return _mm512_or_si512 (d, _mm512_slli_epi16 (w, 8));
+}
+
+/* Put at s the 19 n digits of the limbs {cp,n}, most significant first,
+   each below 10^19.  */
+__attribute__((target("avx2")))
+static void
+get_str_digits_10_avx2 (unsigned char *s, mp_srcptr cp, size_t n)
+{
+  unsigned int g[3 * GET_STR_SIMD_BLOCK];
+  unsigned char t[24 * GET_STR_SIMD_BLOCK];
+  size_t k, i;
+
+  for (; n != 0; n -= k, cp += k, s += 19 * k)
+    {
+      k = n < GET_STR_SIMD_BLOCK ? n : GET_STR_SIMD_BLOCK;
+      get_str_groups_10 (g, cp, k);
+      for (i = 0; i < 3 * k; i += 4)
+        _mm256_storeu_si256 ((__m256i *) (t + 8 * i),
+                             get_str_digits_avx2 (_mm_loadu_si128 ((__m128i *) (g + i))));
+      for (i = 0; i < k; i++)
+        memcpy (s + 19 * i, t + 24 * i + 5, 19);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void
+get_str_digits_10_avx512 (unsigned char *s, mp_srcptr cp, size_t n)
+{
+  unsigned int g[3 * GET_STR_SIMD_BLOCK];
+  unsigned char t[24 * GET_STR_SIMD_BLOCK];
+  size_t k, i;
+
+  for (; n != 0; n -= k, cp += k, s += 19 * k)
+    {
+      k = n < GET_STR_SIMD_BLOCK ? n : GET_STR_SIMD_BLOCK;
+      get_str_groups_10 (g, cp, k);
+      for (i = 0; i < 3 * k; i += 8)
+        _mm512_storeu_si512 ((__m512i *) (t + 8 * i),
+                             get_str_digits_avx512 (_mm256_loadu_si256 ((__m256i *) (g + i))));
+      for (i = 0; i < k; i++)
+        memcpy (s + 19 * i, t + 24 * i + 5, 19);
+    }
+}
+
+static int get_str_simd = -1;	/* 0 plain loop, 1 AVX2, 2 AVX-512 */
+
+/* The kernel for this CPU, or NULL for the plain loop.  The GET_STR_SIMD
+   environment variable, "avx2" or "none", holds it to a lesser one, so that
+   every kernel can be tested on an AVX-512 machine.  */
+static get_str_digits_t
+get_str_digits_10 (void)
+{
+  if (get_str_simd < 0)
+    {
+      const char *env = getenv ("GET_STR_SIMD");
+      int simd = 2;
+
+      if (env != NULL && strcmp (env, "avx2") == 0)
+        simd = 1;
+      else if (env != NULL && strcmp (env, "none") == 0)
+        simd = 0;
+
+      if (simd == 2 && ! __builtin_cpu_supports ("avx512bw"))
+        simd = 1;
+      if (simd == 1 && ! __builtin_cpu_supports ("avx2"))
+        simd = 0;
+      get_str_simd = simd;
+    }
+
+  if (get_str_simd == 2)
+    return get_str_digits_10_avx512;
+  if (get_str_simd == 1)
+    return get_str_digits_10_avx2;
+  return NULL;
+}
+#endif
+
+
 /* Convert {up,un} to a string in base base, and put the result in str.
    Generate len characters, possibly padding with zeros to the left.  If len is
    zero, generate as many characters as required.  Return a pointer immediately
    after the last digit of the result string.  Complexity is O(un^2); intended
-   for small conversions.  */
+   for small conversions.  The digits are written as characters of text, or
+   as their values if text is NULL.  */
 static unsigned char *
 mpn_sb_get_str (unsigned char *str, size_t len,
-		mp_ptr up, mp_size_t un, int base)
+		mp_ptr up, mp_size_t un, int base, const char *text)
 {
   mp_limb_t rl, ul;
   unsigned char *s;
@@ -178,6 +342,10 @@ mpn_sb_get_str (unsigned char *str, size_t len,
 #else
   mp_limb_t rp[GET_STR_PRECOMPUTE_THRESHOLD];
 #endif
+#if GET_STR_SIMD
+  mp_limb_t chunk[BUF_ALLOC / MP_BASES_CHARS_PER_LIMB_10 + 1];
+  get_str_digits_t digits;
+#endif
 
   if (base == 10)
     {
@@ -187,6 +355,31 @@ mpn_sb_get_str (unsigned char *str, size_t len,
       MPN_COPY (rp + 1, up, un);
 
       s = buf + BUF_ALLOC;
+#if GET_STR_SIMD
+      /* Collect the limbs of 19 digits, then convert them all at once.  For
+	 two limbs or less the plain loop is faster.  */
+      if (un > 2 && (digits = get_str_digits_10 ()) != NULL)
+	{
+	  mp_ptr cp = chunk + BUF_ALLOC / MP_BASES_CHARS_PER_LIMB_10 + 1;
+	  size_t n = 0;
+
+	  while (un > 1)
+	    {
+	      mp_limb_t frac, digit;
+	      MPN_DIVREM_OR_PREINV_DIVREM_1 (rp, (mp_size_t) 1, rp + 1, un,
+					     MP_BASES_BIG_BASE_10,
+					     MP_BASES_BIG_BASE_INVERTED_10,
+					     MP_BASES_NORMALIZATION_STEPS_10);
+	      un -= rp[un] == 0;
+	      /* The remainder, from the fraction limb as in the loop below.  */
+	      umul_ppmm (digit, frac, rp[0] + 1, MP_BASES_BIG_BASE_10);
+	      *--cp = digit;
+	      n++;
+	    }
+	  s -= n * MP_BASES_CHARS_PER_LIMB_10;
+	  digits (s, cp, n);
+	}
+#endif
       while (un > 1)
 	{
 	  int i;
@@ -299,6 +492,20 @@ mpn_sb_get_str (unsigned char *str, size_t len,
     }
 
   l = buf + BUF_ALLOC - s;
+  if (text != NULL)
+    {
+      while (l < len)
+	{
+	  *str++ = text[0];
+	  len--;
+	}
+      while (l != 0)
+	{
+	  *str++ = text[*s++];
+	  l--;
+	}
+      return str;
+    }
   while (l < len)
     {
       *str++ = 0;
@@ -313,269 +520,1912 @@ mpn_sb_get_str (unsigned char *str, size_t len,
 }
 
 
-typedef struct {
-  unsigned char *str; size_t len; mp_ptr up; mp_size_t un;
-  const powers_t *powtab; mp_ptr tmp; size_t level, retlen;
-} dc_get_str_t;
+/* Worker pool for the parallel recursion.  The pool is created the first time
+   a split is large enough to be run in parallel and lives until exit, or until
+   mpn_get_str_shutdown is called, so the hot path never creates threads.  Its
+   size counts the calling thread; it defaults to the GET_STR_THREADS
+   environment variable or else the number of online processors, see
+   mpn_get_str_set_threads.
+
+   Scheduling is by work stealing.  Every worker owns a deque of tasks, and
+   threads from outside the pool share one more.  A thread pushes the tasks it
+   spawns at the bottom of its deque and takes them back from there, newest
+   first, while idle threads steal the oldest and biggest tasks from the top
+   of the others.  A thread waiting for a task does not sit idle but runs
+   whatever it can take meanwhile.  The deques are small and tasks are coarse,
+   so one lock guards the whole pool.  */
+
+#ifndef GET_STR_THREAD_THRESHOLD
+#define GET_STR_THREAD_THRESHOLD  100000UL	/* digits */
+#endif
 
-void *thr_dc_get_str (void *arg);
+#define GET_STR_DEQUE_SIZE  64	/* beyond this, spawned tasks run inline */
 
-/* Convert {UP,UN} to a string with a base as represented in POWTAB, and put
-   the string in STR.  Generate LEN characters, possibly padding with zeros to
-   the left.  If LEN is zero, generate as many characters as required.
-   Return a pointer immediately after the last digit of the result string.
-   This uses divide-and-conquer and is intended for large conversions.  */
-static unsigned char *
-mpn_dc_get_str (unsigned char *str, size_t len,
-		mp_ptr up, mp_size_t un,
-		const powers_t *powtab, mp_ptr tmp, size_t level)
+#define GET_STR_TASK_QUEUED   0
+#define GET_STR_TASK_RUNNING  1
+#define GET_STR_TASK_DONE     2
+
+typedef struct get_str_task {
+  void (*func) (struct get_str_task *);
+  int state;
+} get_str_task_t;
+
+void mpn_get_str_shutdown (void);
+void mpn_get_str_set_threads (int);
+int mpn_get_str_get_threads (void);
+
+#if ! defined(GET_STR_SERIAL)
+
+typedef struct {
+  get_str_task_t *task[GET_STR_DEQUE_SIZE];
+  int top, bottom;		/* thieves take at top, the owner at bottom */
+} get_str_deque_t;
+
+static struct {
+  pthread_mutex_t  lock;
+  pthread_cond_t   wake;	/* task queued or finished, or shutdown */
+  get_str_deque_t *deque;	/* nthr + 1 of them, the last for outsiders */
+  pthread_t       *thr;
+  pthread_key_t    self;	/* the deque of a worker */
+  int              nthr;	/* running workers */
+  int              size;	/* configured size, 0 until decided */
+  int              busy;	/* threads inside get_str_sync */
+  int              queued;	/* tasks in the deques */
+  int              active;	/* tasks running */
+  int              started, shutdown, registered;
+  pthread_mutex_t  stop;	/* serializes mpn_get_str_shutdown */
+} get_str_pool = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+  NULL, NULL, 0, 0, 0, 0, 0, 0, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER
+};
+
+/* Take a task, with the pool lock held.  Prefer the newest one in DQ, else
+   steal the oldest one found in the other deques.  */
+static get_str_task_t *
+get_str_take (get_str_deque_t *dq)
 {
-  if (BELOW_THRESHOLD (un, GET_STR_DC_THRESHOLD))
+  get_str_deque_t *v = dq;
+  get_str_task_t *t;
+  int i, n = get_str_pool.nthr + 1;
+
+  if (dq->bottom > dq->top)
+    t = dq->task[--dq->bottom];
+  else
     {
-      if (un != 0)
-        str = mpn_sb_get_str (str, len, up, un, powtab->base);
-      else
+      for (i = 1; i < n; i++)
         {
-          while (len != 0)
-            {
-              *str++ = 0;
-              len--;
-            }
+          v = &get_str_pool.deque[(dq - get_str_pool.deque + i) % n];
+          if (v->bottom > v->top)
+            break;
         }
+      if (i == n)
+        return NULL;
+      t = v->task[v->top++];
     }
-  else
-    {
-      mp_ptr pwp, qp, rp;
-      mp_size_t pwn, qn;
-      mp_size_t sn;
 
-      pwp = powtab->p;
-      pwn = powtab->n;
-      sn = powtab->shift;
+  if (v->top == v->bottom)
+    v->top = v->bottom = 0;
+  get_str_pool.queued--;
+  t->state = GET_STR_TASK_RUNNING;
 
-      if (un < pwn + sn || (un == pwn + sn && mpn_cmp (up + sn, pwp, un - sn) < 0))
-        {
-          str = mpn_dc_get_str (str, len, up, un, powtab - 1, tmp, level);
-        }
-      else
-        {
-          qp = tmp;		/* (un - pwn + 1) limbs for qp */
-          rp = up;		/* pwn limbs for rp; overwrite up area */
+  return t;
+}
 
-          mpn_tdiv_qr (qp, rp + sn, 0L, up + sn, un - sn, pwp, pwn);
-          qn = un - sn - pwn; qn += qp[qn] != 0;		/* quotient size */
+/* Run T, then take the pool lock back.  */
+static void
+get_str_run (get_str_task_t *t)
+{
+  get_str_pool.active++;
+  pthread_mutex_unlock (&get_str_pool.lock);
+  t->func (t);
+  pthread_mutex_lock (&get_str_pool.lock);
+  get_str_pool.active--;
+
+  t->state = GET_STR_TASK_DONE;
+  pthread_cond_broadcast (&get_str_pool.wake);
+}
 
-          ASSERT (qn < pwn + sn || (qn == pwn + sn && mpn_cmp (qp + sn, pwp, pwn) < 0));
+static void *
+get_str_worker (void *arg)
+{
+  get_str_deque_t *dq = (get_str_deque_t *) arg;
+  get_str_task_t *t;
 
-          if (len != 0)
-            len = len - powtab->digits_in_base;
+  pthread_setspecific (get_str_pool.self, dq);
 
-         #if defined(_WIN32) && !defined(_OPENMP)
-          if (level > 1 || powtab->digits_in_base < 500000UL)
-         #else
-          if (level > 3 || powtab->digits_in_base < 500000UL)
-         #endif
-            {
-              str = mpn_dc_get_str (str, len, qp, qn, powtab - 1, tmp + qn, level);
-              str = mpn_dc_get_str (str, powtab->digits_in_base, rp, pwn + sn, powtab - 1, tmp, level);
-            }
-          else
-            {
-              mp_ptr tmp2 = (mp_limb_t *) malloc (sizeof(mp_limb_t) * mpn_dc_get_str_itch(un));
+  /* Leave on shutdown only once every deque is drained.  */
+  pthread_mutex_lock (&get_str_pool.lock);
+  for (;;)
+    {
+      if ((t = get_str_take (dq)) != NULL)
+        get_str_run (t);
+      else if (get_str_pool.shutdown)
+        break;
+      else
+        pthread_cond_wait (&get_str_pool.wake, &get_str_pool.lock);
+    }
+  pthread_mutex_unlock (&get_str_pool.lock);
 
-              unsigned char *str2 = (unsigned char *) malloc(sizeof(char) * powtab->digits_in_base);
-              unsigned char *ptr2 = str2; size_t len2;
+  return ((void *) 0);
+}
 
-              pthread_t    thr2 = 0;
-              dc_get_str_t thr2_arg;
+/* Start the workers, with the pool lock held.  */
+static void
+get_str_pool_start (void)
+{
+  int i, size;
 
-              thr2_arg.str    = str2;
-              thr2_arg.len    = powtab->digits_in_base;
-              thr2_arg.up     = rp;
-              thr2_arg.un     = pwn + sn;
-              thr2_arg.powtab = powtab - 1;
-              thr2_arg.tmp    = tmp2;
-              thr2_arg.level  = ++level;
-              thr2_arg.retlen = 0;
+  get_str_pool.started = 1;
+
+  if ((size = get_str_pool.size) == 0)
+    {
+      const char *env = getenv ("GET_STR_THREADS");
+
+      if (env != NULL)
+        size = atoi (env);
+#if defined(_SC_NPROCESSORS_ONLN)
+      if (size <= 0)
+        size = (int) sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+      if (size <= 0)
+        size = 8;
+      get_str_pool.size = size;
+    }
+
+  if (size <= 1)
+    return;
 
-             #if defined(_WIN32) && (defined(__GNUC__) && __GNUC_VERSION__ < 40800)
-              /* On the Windows platform, run serially if compiled using older GCC */
-              thr_dc_get_str((void *) &thr2_arg);
+  if (! get_str_pool.registered)
+    {
+      if (pthread_key_create (&get_str_pool.self, NULL))
+        return;
+      get_str_pool.registered = 1;
+      atexit (mpn_get_str_shutdown);
+    }
 
-             #else
-              /* If reached ulimit -u threshold, run serially silently */
-              if (pthread_create(&thr2, NULL, thr_dc_get_str, (void *) &thr2_arg))
-                thr2 = 0, thr_dc_get_str((void *) &thr2_arg);
+  get_str_pool.deque = (get_str_deque_t *) calloc (size, sizeof(get_str_deque_t));
+  get_str_pool.thr = (pthread_t *) malloc (sizeof(pthread_t) * (size - 1));
+  if (get_str_pool.deque == NULL || get_str_pool.thr == NULL)
+    {
+      free (get_str_pool.deque);
+      free (get_str_pool.thr);
+      get_str_pool.deque = NULL;
+      get_str_pool.thr = NULL;
+      return;
+    }
 
-             #endif
+  /* If reached ulimit -u threshold, run with fewer workers silently.  The
+     deque after the last worker is the one shared by outside threads.  */
+  for (i = 0; i < size - 1; i++)
+    {
+      if (pthread_create (&get_str_pool.thr[i], NULL, get_str_worker,
+                          (void *) &get_str_pool.deque[i]))
+        break;
+      get_str_pool.nthr++;
+    }
+}
 
-              str = mpn_dc_get_str (str, len, qp, qn, powtab - 1, tmp + qn, level);
+/* Stop the workers, they are started again on demand.  */
+void
+mpn_get_str_shutdown (void)
+{
+  int i;
 
-              if (thr2)
-                pthread_join(thr2, NULL);
+  pthread_mutex_lock (&get_str_pool.stop);
 
-              len2 = thr2_arg.retlen;
+  /* Workers drain the deques before they leave, and new tasks run inline
+     until the pool is marked as stopped.  */
+  pthread_mutex_lock (&get_str_pool.lock);
+  get_str_pool.shutdown = 1;
+  pthread_cond_broadcast (&get_str_pool.wake);
+  pthread_mutex_unlock (&get_str_pool.lock);
 
-              while (len2--)
-                *str++ = *ptr2++;
+  for (i = 0; i < get_str_pool.nthr; i++)
+    pthread_join (get_str_pool.thr[i], NULL);
 
-              free(str2);
-              free(tmp2);
-            }
-        }
+  /* Let outside threads still waiting for a finished task step out before
+     their deque goes away.  */
+  pthread_mutex_lock (&get_str_pool.lock);
+  while (get_str_pool.busy != 0)
+    {
+      pthread_cond_broadcast (&get_str_pool.wake);
+      pthread_cond_wait (&get_str_pool.wake, &get_str_pool.lock);
     }
-
-  return str;
+  free (get_str_pool.deque);
+  free (get_str_pool.thr);
+  get_str_pool.deque = NULL;
+  get_str_pool.thr = NULL;
+  get_str_pool.nthr = 0;
+  get_str_pool.started = 0;
+  get_str_pool.shutdown = 0;
+  pthread_mutex_unlock (&get_str_pool.lock);
+
+  pthread_mutex_unlock (&get_str_pool.stop);
 }
 
-void *
-thr_dc_get_str (void *thr_arg)
+/* Set the pool size, counting the calling thread.  Zero restores the default.
+   A running pool is shut down so that the new size takes effect.  */
+void
+mpn_get_str_set_threads (int nthreads)
 {
-  dc_get_str_t *data = (dc_get_str_t *) thr_arg;
+  mpn_get_str_shutdown ();
 
-  unsigned char *str = mpn_dc_get_str (
-    data->str, data->len, data->up, data->un,
-    data->powtab, data->tmp, data->level
-  );
+  pthread_mutex_lock (&get_str_pool.lock);
+  get_str_pool.size = nthreads < 0 ? 0 : nthreads;
+  pthread_mutex_unlock (&get_str_pool.lock);
+}
 
-  data->retlen = str - data->str;
+int
+mpn_get_str_get_threads (void)
+{
+  int size;
 
-  return ((void *) 0);
+  pthread_mutex_lock (&get_str_pool.lock);
+  if (! get_str_pool.started)
+    get_str_pool_start ();
+  size = get_str_pool.nthr + 1;
+  pthread_mutex_unlock (&get_str_pool.lock);
+
+  return size;
 }
 
-
-/* There are no leading zeros on the digits generated at str, but that's not
-   currently a documented feature.  The current mpz_out_str and mpz_get_str
-   rely on it.  */
+/* Whether spawning tasks is worth it, that is, the pool has workers.  */
+static int
+get_str_parallel (void)
+{
+  return mpn_get_str_get_threads () > 1;
+}
 
-size_t
-mpn_get_str (unsigned char *str, int base, mp_ptr up, mp_size_t un)
+/* Whether some worker has nothing to run, nor a task waiting for it.  A
+   thread running tasks while it waits in get_str_sync counts once per task,
+   so this errs on the busy side.  */
+static int
+get_str_idle (void)
 {
-  mp_ptr powtab_mem, powtab_mem_ptr;
-  mp_limb_t big_base;
-  size_t digits_in_base;
-  powers_t powtab[GMP_LIMB_BITS];
-  int pi;
-  mp_size_t n;
-  mp_ptr p, t;
-  size_t out_len;
-  mp_ptr tmp;
-  TMP_DECL;
+  int idle;
 
-  /* Special case zero, as the code below doesn't handle it.  */
-  if (un == 0)
-    {
-      str[0] = 0;
-      return 1;
-    }
+  pthread_mutex_lock (&get_str_pool.lock);
+  if (! get_str_pool.started)
+    get_str_pool_start ();
+  idle = get_str_pool.active + get_str_pool.queued < get_str_pool.nthr;
+  pthread_mutex_unlock (&get_str_pool.lock);
 
-  if (POW2_P (base))
-    {
-      /* The base is a power of 2.  Convert from most significant end.  */
-      mp_limb_t n1, n0;
-      int bits_per_digit = mp_bases[base].big_base;
-      int cnt;
-      int bit_pos;
-      mp_size_t i;
-      unsigned char *s = str;
-      mp_bitcnt_t bits;
+  return idle;
+}
 
-      n1 = up[un - 1];
-      count_leading_zeros (cnt, n1);
+/* The deque of the calling thread, with the pool lock held.  */
+static get_str_deque_t *
+get_str_deque (void)
+{
+  get_str_deque_t *dq = (get_str_deque_t *) pthread_getspecific (get_str_pool.self);
 
-      /* BIT_POS should be R when input ends in least significant nibble,
-	 R + bits_per_digit * n when input ends in nth least significant
-	 nibble. */
+  return dq != NULL ? dq : &get_str_pool.deque[get_str_pool.nthr];
+}
 
-      bits = (mp_bitcnt_t) GMP_NUMB_BITS * un - cnt + GMP_NAIL_BITS;
-      cnt = bits % bits_per_digit;
-      if (cnt != 0)
-	bits += bits_per_digit - cnt;
-      bit_pos = bits - (mp_bitcnt_t) (un - 1) * GMP_NUMB_BITS;
+/* Push T for the pool, or run it right away if it cannot take it.  */
+static void
+get_str_spawn (get_str_task_t *t)
+{
+  get_str_deque_t *dq;
 
-      /* Fast loop for bit output.  */
-      i = un - 1;
-      for (;;)
-	{
-	  bit_pos -= bits_per_digit;
-	  while (bit_pos >= 0)
-	    {
-	      *s++ = (n1 >> bit_pos) & ((1 << bits_per_digit) - 1);
-	      bit_pos -= bits_per_digit;
-	    }
-	  i--;
-	  if (i < 0)
-	    break;
-	  n0 = (n1 << -bit_pos) & ((1 << bits_per_digit) - 1);
-	  n1 = up[i];
-	  bit_pos += GMP_NUMB_BITS;
-	  *s++ = n0 | (n1 >> bit_pos);
-	}
+  pthread_mutex_lock (&get_str_pool.lock);
+  if (! get_str_pool.started)
+    get_str_pool_start ();
 
-      return s - str;
+  if (get_str_pool.nthr == 0 || get_str_pool.shutdown
+      || (dq = get_str_deque ())->bottom == GET_STR_DEQUE_SIZE)
+    {
+      pthread_mutex_unlock (&get_str_pool.lock);
+      t->func (t);
+      t->state = GET_STR_TASK_DONE;
+      return;
     }
 
-  /* General case.  The base is not a power of 2.  */
+  t->state = GET_STR_TASK_QUEUED;
+  dq->task[dq->bottom++] = t;
+  get_str_pool.queued++;
 
-  if (BELOW_THRESHOLD (un, GET_STR_PRECOMPUTE_THRESHOLD))
-    return mpn_sb_get_str (str, (size_t) 0, up, un, base) - str;
+  pthread_cond_broadcast (&get_str_pool.wake);
+  pthread_mutex_unlock (&get_str_pool.lock);
+}
 
-  TMP_MARK;
+/* Wait for T, running other tasks meanwhile.  Unless stolen, T is the newest
+   task in our deque and so is the first one taken back.  */
+static void
+get_str_sync (get_str_task_t *t)
+{
+  get_str_task_t *u;
 
-  /* Allocate one large block for the powers of big_base.  */
-  powtab_mem = TMP_BALLOC_LIMBS (mpn_dc_get_str_powtab_alloc (un));
-  powtab_mem_ptr = powtab_mem;
+  pthread_mutex_lock (&get_str_pool.lock);
+  get_str_pool.busy++;
+  while (t->state != GET_STR_TASK_DONE)
+    {
+      if ((u = get_str_take (get_str_deque ())) != NULL)
+        get_str_run (u);
+      else
+        pthread_cond_wait (&get_str_pool.wake, &get_str_pool.lock);
+    }
+  get_str_pool.busy--;
+  if (get_str_pool.shutdown)
+    pthread_cond_broadcast (&get_str_pool.wake);
+  pthread_mutex_unlock (&get_str_pool.lock);
+}
 
-  /* Compute a table of powers, were the largest power is >= sqrt(U).  */
+#else
 
-  big_base = mp_bases[base].big_base;
-  digits_in_base = mp_bases[base].chars_per_limb;
+void mpn_get_str_shutdown (void) { }
+void mpn_get_str_set_threads (int nthreads) { }
+int mpn_get_str_get_threads (void) { return 1; }
 
-  {
-    mp_size_t n_pows, xn, pn, exptab[GMP_LIMB_BITS], bexp;
-    mp_limb_t cy;
-    mp_size_t shift;
-    size_t ndig;
+/* On the Windows platform, run serially if compiled using older GCC */
+static int
+get_str_parallel (void)
+{
+  return 0;
+}
 
-    DIGITS_IN_BASE_PER_LIMB (ndig, un, base);
-    xn = 1 + ndig / mp_bases[base].chars_per_limb; /* FIXME: scalar integer division */
+static int
+get_str_idle (void)
+{
+  return 0;
+}
 
-    n_pows = 0;
-    for (pn = xn; pn != 1; pn = (pn + 1) >> 1)
-      {
-	exptab[n_pows] = pn;
-	n_pows++;
-      }
-    exptab[n_pows] = 1;
+static void
+get_str_spawn (get_str_task_t *t)
+{
+  t->func (t);
+  t->state = GET_STR_TASK_DONE;
+}
 
-    powtab[0].p = &big_base;
-    powtab[0].n = 1;
-    powtab[0].digits_in_base = digits_in_base;
-    powtab[0].base = base;
-    powtab[0].shift = 0;
+static void
+get_str_sync (get_str_task_t *t)
+{
+}
 
-    powtab[1].p = powtab_mem_ptr;  powtab_mem_ptr += 2;
-    powtab[1].p[0] = big_base;
-    powtab[1].n = 1;
-    powtab[1].digits_in_base = digits_in_base;
-    powtab[1].base = base;
-    powtab[1].shift = 0;
+#endif
 
-    n = 1;
-    p = &big_base;
-    bexp = 1;
-    shift = 0;
-    for (pi = 2; pi < n_pows; pi++)
-      {
-	t = powtab_mem_ptr;
-	powtab_mem_ptr += 2 * n + 2;
+/* Parallel division for the top levels of the recursion.  There the few
+   divisions in progress leave most of the pool idle, so a division by a
+   large power is done by Newton's method instead, which reduces it to
+   multiplications, and those are split in parts run as tasks.  This does
+   more work than mpn_tdiv_qr and is only used while workers are idle.  */
 
-	ASSERT_ALWAYS (powtab_mem_ptr < powtab_mem + mpn_dc_get_str_powtab_alloc (un));
+#ifndef GET_STR_DIV_THRESHOLD
+#define GET_STR_DIV_THRESHOLD  20000	/* limbs */
+#endif
 
-	mpn_sqr (t, p, n);
+#ifndef GET_STR_MUL_THRESHOLD
+#define GET_STR_MUL_THRESHOLD  4000	/* limbs */
+#endif
 
-	digits_in_base *= 2;
-	n *= 2;  n -= t[n - 1] == 0;
+/* The entries of the power table.  These are the powers_t of gmp-impl.h
+   plus the reciprocal of the reciprocal engine, which the library's struct
+   has no room for.  */
+typedef struct {
+  mp_ptr p;			/* actual power value */
+  mp_size_t n;			/* # of limbs at p */
+  mp_size_t shift;		/* weight of lowest limb, in limb base B */
+  size_t digits_in_base;	/* number of corresponding digits */
+  int base;
+  mp_ptr inv;			/* reciprocal of the power, or NULL */
+} get_str_powers_t;
+
+/* Powers from this size have a reciprocal with the reciprocal engine, see
+   get_str_inv_get.  Numbers below the square of the power at pt need
+   GET_STR_INV_SIZE(pt) limbs of it.  */
+#ifndef GET_STR_INV_THRESHOLD
+#define GET_STR_INV_THRESHOLD  2000	/* limbs */
+#endif
+
+#define GET_STR_INV_SIZE(pt)  ((pt)->n + (pt)->shift + 3)
+
+typedef struct {
+  get_str_task_t task;
+  mp_ptr rp; mp_srcptr ap; mp_size_t an; mp_srcptr bp; mp_size_t bn;
+} get_str_mul_t;
+
+static void thr_get_str_mul (get_str_task_t *task);
+
+static void
+get_str_mul_spawn (get_str_mul_t *m, mp_ptr rp,
+		   mp_srcptr ap, mp_size_t an, mp_srcptr bp, mp_size_t bn)
+{
+  m->rp = rp;
+  m->ap = ap;
+  m->an = an;
+  m->bp = bp;
+  m->bn = bn;
+  m->task.func = thr_get_str_mul;
+
+  get_str_spawn (&m->task);
+}
+
+/* Put in {rp,an+bn} the product of {ap,an} and {bp,bn}, an >= bn >= 1.  A
+   large product is split in parts multiplied as tasks: an operand at least
+   twice as long as the other in pieces of bn limbs, which adds no work, else
+   both in halves using Karatsuba's identity.  Splitting stops once the pool
+   has enough to do, since each Karatsuba split adds work.  With the same
+   operands twice, this squares like mpn_mul.  */
+static void
+get_str_mul (mp_ptr rp, mp_srcptr ap, mp_size_t an, mp_srcptr bp, mp_size_t bn)
+{
+  if (bn < GET_STR_MUL_THRESHOLD || ! get_str_idle ())
+    {
+      mpn_mul (rp, ap, an, bp, bn);
+    }
+  else if (an >= 2 * bn)
+    {
+      /* Pieces with an even index go straight to rp, where their products
+         do not overlap, those with an odd index are added afterwards.  */
+      mp_size_t k = an / bn, i, end;
+      get_str_mul_t *m;
+      mp_ptr tp, t;
+
+      m = (get_str_mul_t *) malloc (sizeof(get_str_mul_t) * k);
+      tp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * (an + (k / 2) * bn));
+
+      for (i = 0, t = tp; i < k - 1; i++)
+        {
+          if (i % 2 == 0)
+            get_str_mul_spawn (&m[i], rp + i * bn, ap + i * bn, bn, bp, bn);
+          else
+            {
+              get_str_mul_spawn (&m[i], t, ap + i * bn, bn, bp, bn);
+              t += 2 * bn;
+            }
+        }
+      get_str_mul (i % 2 == 0 ? rp + i * bn : t,
+                   ap + i * bn, an - i * bn, bp, bn);
+      for (i = k - 2; i >= 0; i--)
+        get_str_sync (&m[i].task);
+
+      end = (k - 1) % 2 == 0 ? an + bn : k * bn;
+      if (end < an + bn)
+        MPN_ZERO (rp + end, an + bn - end);
+
+      for (i = 1, t = tp; i < k; i += 2, t += 2 * bn)
+        mpn_add (rp + i * bn, rp + i * bn, an + bn - i * bn,
+                 t, i < k - 1 ? 2 * bn : an + bn - i * bn);
+
+      free (tp);
+      free (m);
+    }
+  else
+    {
+      /* With a = a1 B^h + a0 and b = b1 B^h + b0, the product is
+         z2 B^2h + (z1 - z2 - z0) B^h + z0, where z0 = a0 b0, z2 = a1 b1 and
+         z1 = (a0 + a1) (b0 + b1).  z0 and z2 go straight to rp.  */
+      mp_size_t h = (an + 1) / 2, sa, sb, zn;
+      get_str_mul_t m0, m2;
+      mp_ptr tp, z1;
+
+      if (bn <= h)
+        h = bn - 1;
+
+      tp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * 2 * (an + 4));
+      z1 = tp + an + 4;
+
+      get_str_mul_spawn (&m0, rp, ap, h, bp, h);
+      get_str_mul_spawn (&m2, rp + 2 * h, ap + h, an - h, bp + h, bn - h);
+
+      if (an - h >= h)
+        {
+          sa = an - h;
+          tp[sa] = mpn_add (tp, ap + h, sa, ap, h);
+        }
+      else
+        {
+          sa = h;
+          tp[sa] = mpn_add (tp, ap, sa, ap + h, an - h);
+        }
+      sa++;
+
+      if (ap == bp && an == bn)
+        {
+          sb = sa;
+          get_str_mul (z1, tp, sa, tp, sa);
+        }
+      else
+        {
+          sb = h;
+          tp[sa + sb] = mpn_add (tp + sa, bp, sb, bp + h, bn - h);
+          sb++;
+
+          if (sa >= sb)
+            get_str_mul (z1, tp, sa, tp + sa, sb);
+          else
+            get_str_mul (z1, tp + sa, sb, tp, sa);
+        }
+
+      get_str_sync (&m2.task);
+      get_str_sync (&m0.task);
+
+      zn = sa + sb;
+      mpn_sub (z1, z1, zn, rp, 2 * h);
+      mpn_sub (z1, z1, zn, rp + 2 * h, an + bn - 2 * h);
+      while (zn > 0 && z1[zn - 1] == 0)
+        zn--;
+      if (zn != 0)
+        mpn_add (rp + h, rp + h, an + bn - h, z1, zn);
+
+      free (tp);
+    }
+}
+
+static void
+thr_get_str_mul (get_str_task_t *task)
+{
+  get_str_mul_t *data = (get_str_mul_t *) task;
+
+  get_str_mul (data->rp, data->ap, data->an, data->bp, data->bn);
+}
+
+/* Put in {vp,k+2} an approximation to B^2k / {dp,k}, within a few units.
+   The high limb of {dp,k} must be non-zero.  Each Newton step doubles the
+   precision of the reciprocal of the high part of {dp,k}, with three guard
+   limbs so that the error in the end is below one unit plus truncation.  */
+static void
+get_str_invert (mp_ptr vp, mp_srcptr dp, mp_size_t k)
+{
+  mp_ptr tp, vh, pp, ep;
+  mp_size_t h, vhn, pn, en, cn;
+  int neg;
+
+  if (k < GET_STR_DIV_THRESHOLD)
+    {
+      tp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * (3 * k + 1));
+      MPN_ZERO (tp, 2 * k);
+      tp[2 * k] = 1;
+      mpn_tdiv_qr (vp, tp + 2 * k + 1, 0L, tp, 2 * k + 1, dp, k);
+      free (tp);
+      return;
+    }
+
+  h = k / 2 + 3;
+  tp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * ((h + 2) + (k + 2 * h + 4) + (k + h + 3)));
+  vh = tp;
+  pp = vh + h + 2;
+  ep = pp + k + 2 * h + 4;
+
+  /* X0 = Vh B^(k-h), for Vh the reciprocal of the high h limbs.  */
+  get_str_invert (vh, dp + k - h, h);
+  vhn = h + 2;
+  while (vh[vhn - 1] == 0)
+    vhn--;
+
+  /* E = B^(k+h) - D Vh, in sign and magnitude.  */
+  get_str_mul (pp, dp, k, vh, vhn);
+  pn = k + vhn;
+  while (pn > 0 && pp[pn - 1] == 0)
+    pn--;
+  MPN_ZERO (ep, k + h);
+  ep[k + h] = 1;
+  neg = pn > k + h + 1 || (pn == k + h + 1 && mpn_cmp (pp, ep, pn) > 0);
+  if (neg)
+    mpn_sub (ep, pp, pn, ep, k + h + 1);
+  else
+    mpn_sub (ep, ep, k + h + 1, pp, pn);
+  en = neg ? pn : k + h + 1;
+  while (en > 0 && ep[en - 1] == 0)
+    en--;
+
+  /* X1 = X0 + X0 E / B^2k = Vh B^(k-h) + Vh E / B^2h.  */
+  MPN_ZERO (vp, k - h);
+  MPN_COPY (vp + k - h, vh, h + 2);
+  if (en != 0)
+    {
+      if (en >= vhn)
+        get_str_mul (pp, ep, en, vh, vhn);
+      else
+        get_str_mul (pp, vh, vhn, ep, en);
+      cn = en + vhn - 2 * h;
+      while (cn > 0 && pp[2 * h + cn - 1] == 0)
+        cn--;
+      ASSERT (cn <= k + 2);
+      if (cn > 0)
+        {
+          if (neg)
+            mpn_sub (vp, vp, k + 2, pp + 2 * h, cn);
+          else
+            mpn_add (vp, vp, k + 2, pp + 2 * h, cn);
+        }
+    }
+
+  free (tp);
+}
+
+/* Compare {ap,an} and {bp,bn}, either may have high zero limbs.  */
+static int
+get_str_cmp (mp_srcptr ap, mp_size_t an, mp_srcptr bp, mp_size_t bn)
+{
+  while (an > 0 && ap[an - 1] == 0)
+    an--;
+  while (bn > 0 && bp[bn - 1] == 0)
+    bn--;
+  if (an != bn)
+    return an < bn ? -1 : 1;
+  return mpn_cmp (ap, bp, an);
+}
+
+/* Divide {np,nn} by {dp,dn} like mpn_tdiv_qr, putting nn-dn+1 quotient limbs
+   at qp and dn remainder limbs at rp, which may be np.
+
+   The quotient comes from the high limbs of N times a reciprocal of the high
+   limbs of D, which is within a few units of the true quotient.  It is then
+   corrected from the remainder.  Should that take more than a few steps,
+   mpn_tdiv_qr does the division after all.
+
+   If ip is not NULL, {ip,ik+2} is B^(ik+dn) / D within a few units, as from
+   get_str_invert on D padded to ik limbs.  When precise enough for qn it
+   replaces computing the reciprocal, leaving two multiplications, which is
+   less work than mpn_tdiv_qr and so done whether workers are idle or not.  */
+static void
+get_str_tdiv_qr (mp_ptr qp, mp_ptr rp,
+		 mp_srcptr np, mp_size_t nn, mp_srcptr dp, mp_size_t dn,
+		 mp_srcptr ip, mp_size_t ik)
+{
+  mp_ptr tp, xp, pp;
+  mp_srcptr vp;
+  mp_size_t qn = nn - dn + 1, k, i;
+
+  if (ip != NULL && (qn + 2 > ik || qn < GET_STR_INV_THRESHOLD))
+    ip = NULL;
+
+  if (ip == NULL
+      && (dn < GET_STR_DIV_THRESHOLD || qn < GET_STR_DIV_THRESHOLD || ! get_str_idle ()))
+    {
+      mpn_tdiv_qr (qp, rp, 0L, np, nn, dp, dn);
+      return;
+    }
+
+  /* V is the reciprocal of D to qn + 2 limbs, from its high limbs or from D
+     padded with low zero limbs.  */
+  k = qn + 2;
+  i = qn + k + 3 + (ip == NULL ? k + 2 : 0);
+  if (i < qn + nn + 3)
+    i = qn + nn + 3;
+  tp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * i);
+
+  /* The approximate quotient takes the low qn + 1 limbs at xp, its product
+     with D, then the remainder, the nn + 2 limbs above, where V and the
+     high limbs of its product with N were before.  */
+  xp = tp;
+  pp = tp + qn + 1;
+  vp = tp + qn + k + 3;
+
+  if (ip != NULL)
+    vp = ip + (ik - k);		/* the high k + 2 limbs */
+  else if (k <= dn)
+    get_str_invert (tp + qn + k + 3, dp + dn - k, k);
+  else
+    {
+      MPN_ZERO (tp, k - dn);
+      MPN_COPY (tp + k - dn, dp, dn);
+      get_str_invert (tp + qn + k + 3, tp, k);
+    }
+
+  /* X = floor (N / B^(dn-2) * V / B^(k+2)).  */
+  get_str_mul (xp, vp, k + 2, np + dn - 2, qn + 1);
+  MPN_COPY_INCR (xp, xp + k + 2, qn + 1);
+
+  i = qn + 1;
+  while (i > 0 && xp[i - 1] == 0)
+    i--;
+  if (i == 0)
+    MPN_ZERO (pp, nn + 2);
+  else
+    {
+      if (i >= dn)
+        get_str_mul (pp, xp, i, dp, dn);
+      else
+        get_str_mul (pp, dp, dn, xp, i);
+      if (i + dn < nn + 2)
+        MPN_ZERO (pp + i + dn, nn + 2 - i - dn);
+    }
+
+  /* Step X down while X D > N, then up while N - X D >= D.  */
+  for (i = 0; i <= 4 && get_str_cmp (pp, nn + 2, np, nn) > 0; i++)
+    {
+      mpn_sub (pp, pp, nn + 2, dp, dn);
+      mpn_sub_1 (xp, xp, qn + 1, 1);
+    }
+  if (i <= 4)
+    {
+      mpn_sub (pp, np, nn, pp, nn);
+      for (; i <= 4 && get_str_cmp (pp, nn, dp, dn) >= 0; i++)
+        {
+          mpn_sub (pp, pp, nn, dp, dn);
+          mpn_add_1 (xp, xp, qn + 1, 1);
+        }
+    }
+
+  if (i > 4)
+    mpn_tdiv_qr (qp, rp, 0L, np, nn, dp, dn);
+  else
+    {
+      MPN_COPY (qp, xp, qn);
+      MPN_COPY (rp, pp, dn);
+    }
+
+  free (tp);
+}
+
+/* Low-memory mode.  mpn_dc_get_str leaves the remainder of a division in
+   the up area and puts the quotient in the scratch, whose conversion takes
+   the scratch beyond it, so that the quotients down a path of the recursion
+   add up to about as many limbs as U.  In the low-memory mode a quotient
+   moves to the up area too, above the remainder, and the scratch then only
+   holds the quotient of one division at a time, about half as many limbs.
+   A spawned remainder gets scratch sized to it, in either mode.
+
+   The mode is off by default; it defaults to the GET_STR_LOWMEM environment
+   variable, see mpn_get_str_set_lowmem.  */
+
+void mpn_get_str_set_lowmem (int);
+int mpn_get_str_get_lowmem (void);
+
+static int get_str_lowmem = -1;	/* -1 until decided */
+
+/* Turn the low-memory mode on with a non-zero argument, else off.  */
+void
+mpn_get_str_set_lowmem (int lowmem)
+{
+  get_str_lowmem = lowmem != 0;
+}
+
+int
+mpn_get_str_get_lowmem (void)
+{
+  if (get_str_lowmem < 0)
+    {
+      const char *env = getenv ("GET_STR_LOWMEM");
+
+      get_str_lowmem = env != NULL && atoi (env) != 0;
+    }
+
+  return get_str_lowmem;
+}
+
+/* Scratch for converting un limbs with mpn_dc_get_str.  In the low-memory
+   mode a quotient one limb too long for the room above the remainder stays
+   in the scratch; should that leave too little for the next one,
+   mpn_dc_get_str allocates it.  */
+static mp_size_t
+get_str_dc_itch (mp_size_t un)
+{
+  if (mpn_get_str_get_lowmem ())
+    return un / 2 + GMP_LIMB_BITS;
+  return mpn_dc_get_str_itch (un);
+}
+
+typedef struct {
+  get_str_task_t task;
+  unsigned char *str; size_t len; mp_ptr up; mp_size_t un;
+  const get_str_powers_t *powtab; const char *text;
+} dc_get_str_t;
+
+static void thr_dc_get_str (get_str_task_t *task);
+
+/* Convert {UP,UN} to a string with a base as represented in POWTAB, and put
+   the string in STR.  Generate LEN characters, possibly padding with zeros to
+   the left.  If LEN is zero, generate as many characters as required.
+   Return a pointer immediately after the last digit of the result string.
+   The digits are characters of TEXT, or their values if TEXT is NULL.
+   TMP is scratch of TN limbs, see get_str_dc_itch.
+   This uses divide-and-conquer and is intended for large conversions.  */
+static unsigned char *
+mpn_dc_get_str (unsigned char *str, size_t len,
+		mp_ptr up, mp_size_t un,
+		const get_str_powers_t *powtab, mp_ptr tmp, mp_size_t tn, const char *text)
+{
+  if (BELOW_THRESHOLD (un, GET_STR_DC_THRESHOLD))
+    {
+      if (un != 0)
+        str = mpn_sb_get_str (str, len, up, un, powtab->base, text);
+      else
+        {
+          while (len != 0)
+            {
+              *str++ = text == NULL ? 0 : text[0];
+              len--;
+            }
+        }
+    }
+  else
+    {
+      mp_ptr pwp, qp, rp, qmem, qtmp;
+      mp_size_t pwn, qn;
+      mp_size_t sn, qtn;
+
+      pwp = powtab->p;
+      pwn = powtab->n;
+      sn = powtab->shift;
+
+      if (un < pwn + sn || (un == pwn + sn && mpn_cmp (up + sn, pwp, un - sn) < 0))
+        {
+          str = mpn_dc_get_str (str, len, up, un, powtab - 1, tmp, tn, text);
+        }
+      else
+        {
+          qp = tmp;		/* (un - pwn + 1) limbs for qp */
+          rp = up;		/* pwn limbs for rp; overwrite up area */
+
+          /* Only the scratch of the low-memory mode can be short.  */
+          qmem = NULL;
+          if (un - sn - pwn + 1 > tn)
+            qp = qmem = (mp_limb_t *) malloc (sizeof(mp_limb_t) * (un - sn - pwn + 1));
+
+          get_str_tdiv_qr (qp, rp + sn, up + sn, un - sn, pwp, pwn,
+                           powtab->inv, GET_STR_INV_SIZE (powtab));
+          qn = un - sn - pwn; qn += qp[qn] != 0;		/* quotient size */
+
+          ASSERT (qn < pwn + sn || (qn == pwn + sn && mpn_cmp (qp + sn, pwp, pwn) < 0));
+
+          /* In the low-memory mode the quotient moves to the up area above
+             the remainder, when it is not one limb too long for it, and
+             leaves the whole scratch to its conversion.  */
+          qtmp = tmp + qn;
+          qtn = tn - qn;
+          if (qmem != NULL)
+            {
+              qtmp = tmp;
+              qtn = tn;
+            }
+          if (mpn_get_str_get_lowmem () && qn <= un - sn - pwn)
+            {
+              MPN_COPY (up + sn + pwn, qp, qn);
+              qp = up + sn + pwn;
+              free (qmem);
+              qmem = NULL;
+              qtmp = tmp;
+              qtn = tn;
+            }
+
+          if (len != 0)
+            len = len - powtab->digits_in_base;
+
+          /* Spawn the remainder when it is enough work to pay off.  */
+          if (powtab->digits_in_base < GET_STR_THREAD_THRESHOLD || ! get_str_parallel ())
+            {
+              str = mpn_dc_get_str (str, len, qp, qn, powtab - 1, qtmp, qtn, text);
+              free (qmem);
+              str = mpn_dc_get_str (str, powtab->digits_in_base, rp, pwn + sn, powtab - 1, tmp, tn, text);
+            }
+          else
+            {
+              dc_get_str_t thr2_arg;
+
+              /* The remainder always fills exactly digits_in_base characters,
+                 so it can go straight to its final place behind the quotient.
+                 For the leftmost part the quotient width is not known, use an
+                 estimate which is exact or one too big; mpn_get_str strips a
+                 resulting leading zero.  */
+              if (len == 0)
+                MPN_SIZEINBASE (len, qp, qn, powtab->base);
+
+              thr2_arg.str    = str + len;
+              thr2_arg.len    = powtab->digits_in_base;
+              thr2_arg.up     = rp;
+              thr2_arg.un     = pwn + sn;
+              thr2_arg.powtab = powtab - 1;
+              thr2_arg.text   = text;
+              thr2_arg.task.func = thr_dc_get_str;
+
+              get_str_spawn (&thr2_arg.task);
+
+              str = mpn_dc_get_str (str, len, qp, qn, powtab - 1, qtmp, qtn, text);
+              free (qmem);
+
+              get_str_sync (&thr2_arg.task);
+
+              str += powtab->digits_in_base;
+            }
+        }
+    }
+
+  return str;
+}
+
+static void
+thr_dc_get_str (get_str_task_t *task)
+{
+  dc_get_str_t *data = (dc_get_str_t *) task;
+
+  /* Scratch sized to this part only, allocated once the task runs, so that
+     queued tasks hold no memory.  */
+  mp_size_t tn = get_str_dc_itch (data->un);
+  mp_ptr tmp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * tn);
+
+  mpn_dc_get_str (
+    data->str, data->len, data->up, data->un,
+    data->powtab, tmp, tn, data->text
+  );
+
+  free(tmp);
+}
+
+/* Split mode.  Instead of letting the recursion fan out from the top, the
+   number is first cut in parts of equal width, one per thread or so, which
+   are then converted as independent tasks.  The parts are the leaves of a
+   remainder tree over the cached powers big_base^(2^i): the nodes of each
+   level of the tree are divided at the same time, one task each, and every
+   part has a known width, so it goes straight to its place in the string.
+
+   The mode needs the exact squares of the power table cache, without it the
+   conversion is done as usual.  It is off by default; the number of parts
+   defaults to the GET_STR_SPLIT environment variable, see
+   mpn_get_str_set_split.  */
+
+void mpn_get_str_set_split (int);
+int mpn_get_str_get_split (void);
+
+static int get_str_nparts = -1;	/* -1 until decided */
+
+/* Set the number of parts, rounded up to a power of two.  Zero or one turns
+   the split mode off.  */
+void
+mpn_get_str_set_split (int parts)
+{
+  get_str_nparts = parts < 0 ? 0 : parts;
+}
+
+int
+mpn_get_str_get_split (void)
+{
+  if (get_str_nparts < 0)
+    {
+      const char *env = getenv ("GET_STR_SPLIT");
+      int parts = 0;
+
+      if (env != NULL)
+        parts = atoi (env);
+      get_str_nparts = parts < 0 ? 0 : parts;
+    }
+
+  return get_str_nparts;
+}
+
+typedef struct {
+  get_str_task_t task;
+  mp_ptr up; mp_size_t un;	/* node, then the remainder in place */
+  mp_ptr qp; mp_size_t qn;	/* quotient, allocated here */
+  const get_str_powers_t *powtab;
+} split_get_str_t;
+
+/* Divide a node of the remainder tree by the power at powtab.  Both parts
+   are normalized, a zero part has no limbs.  */
+static void
+thr_split_get_str (get_str_task_t *task)
+{
+  split_get_str_t *data = (split_get_str_t *) task;
+  mp_ptr up = data->up, pwp = data->powtab->p;
+  mp_size_t un = data->un, pwn = data->powtab->n, sn = data->powtab->shift;
+
+  data->qp = NULL;
+  data->qn = 0;
+
+  if (un > pwn + sn || (un == pwn + sn && mpn_cmp (up + sn, pwp, un - sn) >= 0))
+    {
+      data->qn = un - sn - pwn + 1;
+      data->qp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * data->qn);
+      get_str_tdiv_qr (data->qp, up + sn, up + sn, un - sn, pwp, pwn,
+                       data->powtab->inv, GET_STR_INV_SIZE (data->powtab));
+      un = pwn + sn;
+      while (data->qp[data->qn - 1] == 0)
+        data->qn--;
+    }
+  while (un > 0 && up[un - 1] == 0)
+    un--;
+  data->un = un;
+}
+
+/* Convert {up,un} in 2^d parts, powtab being the top of the cached table,
+   to len characters, or as many as required if len is zero.  The nodes are
+   numbered as in a heap, node i having the quotient 2i and the remainder
+   2i+1 as children, so the leaves 2^d..2^(d+1)-1 are the parts from left to
+   right.  Level l is divided by the power at powtab - l, and the parts are
+   below the power at powtab - d + 1, whose number of digits is their
+   width.  */
+static unsigned char *
+mpn_split_get_str (unsigned char *str, size_t len, mp_ptr up, mp_size_t un,
+		   const get_str_powers_t *powtab, int d, const char *text)
+{
+  split_get_str_t *node;
+  dc_get_str_t *part;
+  int nparts = 1 << d, i, l;
+
+  node = (split_get_str_t *) malloc (sizeof(split_get_str_t) * 2 * nparts);
+  part = (dc_get_str_t *) malloc (sizeof(dc_get_str_t) * nparts);
+
+  node[1].up = up;
+  node[1].un = un;
+
+  for (l = 0; l < d; l++)
+    {
+      for (i = 1 << l; i < 2 << l; i++)
+        {
+          node[i].powtab = powtab - l;
+          node[i].task.func = thr_split_get_str;
+          if (i < (2 << l) - 1)
+            get_str_spawn (&node[i].task);
+        }
+      thr_split_get_str (&node[i - 1].task);
+      for (i = (2 << l) - 2; i >= 1 << l; i--)
+        get_str_sync (&node[i].task);
+
+      for (i = 1 << l; i < 2 << l; i++)
+        {
+          node[2 * i].up = node[i].qp;
+          node[2 * i].un = node[i].qn;
+          node[2 * i + 1].up = node[i].up;
+          node[2 * i + 1].un = node[i].un;
+        }
+    }
+
+  /* With len zero, parts left of the first non-zero one give no
+     characters, the width of that one is an estimate which is exact or one
+     too big.  */
+  i = 0;
+  if (len == 0)
+    {
+      for (; node[nparts + i].un == 0; i++)
+        part[i].len = 0;
+      MPN_SIZEINBASE (part[i].len, node[nparts + i].up, node[nparts + i].un, powtab->base);
+      i++;
+    }
+  for (; i < nparts; i++)
+    part[i].len = (powtab - d + 1)->digits_in_base;
+
+  /* A node below a lower power than its width calls for is padded.  */
+  for (; len > nparts * (powtab - d + 1)->digits_in_base; len--)
+    *str++ = text == NULL ? 0 : text[0];
+
+  for (i = 0; i < nparts; i++)
+    {
+      part[i].str    = str;
+      part[i].up     = node[nparts + i].up;
+      part[i].un     = node[nparts + i].un;
+      part[i].powtab = powtab - d;
+      part[i].text   = text;
+      part[i].task.func = thr_dc_get_str;
+      str += part[i].len;
+      if (part[i].len != 0 && i < nparts - 1)
+        get_str_spawn (&part[i].task);
+    }
+  thr_dc_get_str (&part[nparts - 1].task);
+  for (i = nparts - 2; i >= 0; i--)
+    if (part[i].len != 0)
+      get_str_sync (&part[i].task);
+
+  for (i = 1; i < nparts; i++)
+    free (node[i].qp);
+  free (part);
+  free (node);
+
+  return str;
+}
+
+/* The depth of the remainder tree for converting with the table powtab of
+   top + 1 levels, or zero to convert as usual.  */
+static int
+get_str_split_depth (const get_str_powers_t *powtab, int top)
+{
+  int parts = mpn_get_str_get_split (), d = 0;
+
+  if (parts < 2 || powtab[top].digits_in_base < GET_STR_THREAD_THRESHOLD
+      || ! get_str_parallel ())
+    return 0;
+
+  while ((1 << d) < parts && d < top)
+    d++;
+
+  return d;
+}
+
+/* Scaled remainder tree, the engine of algorithm B.  U is divided once by a
+   power P above it, giving the fraction y = U/P to a few more limbs than P.
+   A node is a fraction y below a power P = P_hi P_lo of the table, which is
+   made of pure squares, so P_hi = P_lo.  The digits of y P_hi are those of
+   the left half, its fractional part has the digits of the right half, so
+   one truncated multiplication by P_lo gives the right half, while the left
+   half is y itself, truncated to the precision of the level below.  At the
+   leaves, multiplying by big_base repeatedly develops the digits from the
+   left, chars_per_limb at a time.  No node divides.
+
+   The fractions are kept with three guard limbs and always truncated.  A
+   node y stands for U_node/P + e/P, 0 < e < 1, giving the digits of U_node
+   exactly.  Truncating takes e down by less than B^-3 a level.  The left
+   half inherits e = (lo + e)/P_lo, which would be tiny for lo zero, so when
+   the fraction of the right half shows e below one half, B^-(n+1) is added
+   to the left half, P having n limbs, bringing e above B^-2.  */
+
+#define GET_STR_FRAC_SIZE(pt)  ((pt)->n + (pt)->shift + 3)
+
+typedef struct {
+  get_str_task_t task;
+  unsigned char *str; size_t len; mp_ptr yp;
+  const get_str_powers_t *powtab; const char *text;
+} srt_get_str_t;
+
+static void thr_srt_get_str (get_str_task_t *task);
+
+/* Scratch for mpn_srt_get_str at powtab.  */
+static mp_size_t
+get_str_srt_itch (const get_str_powers_t *powtab)
+{
+  mp_size_t itch = 0;
+
+  for (; ! BELOW_THRESHOLD (powtab->n + powtab->shift, GET_STR_DC_THRESHOLD); powtab--)
+    itch += GET_STR_FRAC_SIZE (powtab) + (powtab - 1)->n;
+
+  return itch;
+}
+
+/* Put in str the last len of the digits of the fraction {yp,m} below the
+   power at powtab, m being GET_STR_FRAC_SIZE(powtab), by algorithm B.  The
+   fraction is destroyed.  */
+static unsigned char *
+mpn_srt_get_str_leaf (unsigned char *str, size_t len, mp_ptr yp,
+		      const get_str_powers_t *powtab, const char *text)
+{
+  unsigned char buf[BUF_ALLOC];
+  mp_size_t m = GET_STR_FRAC_SIZE (powtab);
+  size_t i, nchunks, chars_per_limb;
+  unsigned char *s;
+  mp_limb_t ul, rl;
+  int base = powtab->base, j;
+#if GET_STR_SIMD
+  mp_limb_t chunk[BUF_ALLOC / MP_BASES_CHARS_PER_LIMB_10 + 1];
+  get_str_digits_t digits;
+#endif
+
+  chars_per_limb = mp_bases[base].chars_per_limb;
+  nchunks = powtab->digits_in_base / chars_per_limb;
+  ASSERT (powtab->digits_in_base <= BUF_ALLOC);
+
+  s = buf;
+  if (base == 10)
+    {
+      i = 0;
+#if GET_STR_SIMD
+      if (nchunks > 2 && (digits = get_str_digits_10 ()) != NULL)
+	{
+	  for (; i < nchunks; i++)
+	    chunk[i] = mpn_mul_1 (yp, yp, m, MP_BASES_BIG_BASE_10);
+	  digits (s, chunk, nchunks);
+	  s += nchunks * MP_BASES_CHARS_PER_LIMB_10;
+	}
+#endif
+      for (; i < nchunks; i++)
+	{
+	  ul = mpn_mul_1 (yp, yp, m, MP_BASES_BIG_BASE_10);
+	  for (j = MP_BASES_CHARS_PER_LIMB_10 - 1; j >= 0; j--)
+	    {
+	      udiv_qrnd_unnorm (ul, rl, ul, 10);
+	      s[j] = rl;
+	    }
+	  s += MP_BASES_CHARS_PER_LIMB_10;
+	}
+    }
+  else
+    {
+      for (i = 0; i < nchunks; i++)
+	{
+	  ul = mpn_mul_1 (yp, yp, m, mp_bases[base].big_base);
+	  for (j = chars_per_limb - 1; j >= 0; j--)
+	    {
+	      udiv_qrnd_unnorm (ul, rl, ul, base);
+	      s[j] = rl;
+	    }
+	  s += chars_per_limb;
+	}
+    }
+
+  for (s -= len; len != 0; len--)
+    *str++ = text == NULL ? *s++ : text[*s++];
+
+  return str;
+}
+
+/* Convert the fraction {yp,m} below the power at powtab, m being
+   GET_STR_FRAC_SIZE(powtab), to the last len of its digits_in_base digits,
+   the others being zero.  Return a pointer immediately after the last
+   digit.  The fraction is destroyed.  tmp has get_str_srt_itch limbs.  */
+static unsigned char *
+mpn_srt_get_str (unsigned char *str, size_t len, mp_ptr yp,
+		 const get_str_powers_t *powtab, mp_ptr tmp, const char *text)
+{
+  const get_str_powers_t *lo = powtab - 1;
+  mp_size_t m, mlo;
+  mp_ptr pp, ylo, yhi;
+  size_t wlo;
+
+  if (BELOW_THRESHOLD (powtab->n + powtab->shift, GET_STR_DC_THRESHOLD))
+    return mpn_srt_get_str_leaf (str, len, yp, powtab, text);
+
+  m = GET_STR_FRAC_SIZE (powtab);
+  mlo = GET_STR_FRAC_SIZE (lo);
+  wlo = lo->digits_in_base;
+
+  /* The right half, the high limbs of the fractional part of y P_lo.  */
+  pp = tmp;
+  get_str_mul (pp, yp, m, lo->p, lo->n);
+  ylo = pp + m - mlo - lo->shift;
+
+  if (len <= wlo)
+    return mpn_srt_get_str (str, len, ylo, lo, tmp + m + lo->n, text);
+
+  /* The left half.  */
+  yhi = yp + m - mlo;
+  if ((ylo[mlo - 1] >> (GMP_LIMB_BITS - 1)) == 0)
+    mpn_add_1 (yhi + 2, yhi + 2, mlo - 2, CNST_LIMB(1));
+
+  /* Spawn the right half when it is enough work to pay off.  */
+  if (powtab->digits_in_base < GET_STR_THREAD_THRESHOLD || ! get_str_parallel ())
+    {
+      str = mpn_srt_get_str (str, len - wlo, yhi, lo, tmp + m + lo->n, text);
+      str = mpn_srt_get_str (str, wlo, ylo, lo, tmp + m + lo->n, text);
+    }
+  else
+    {
+      srt_get_str_t thr2_arg;
+
+      thr2_arg.str    = str + len - wlo;
+      thr2_arg.len    = wlo;
+      thr2_arg.yp     = (mp_limb_t *) malloc (sizeof(mp_limb_t) * mlo);
+      thr2_arg.powtab = lo;
+      thr2_arg.text   = text;
+      thr2_arg.task.func = thr_srt_get_str;
+      MPN_COPY (thr2_arg.yp, ylo, mlo);
+
+      get_str_spawn (&thr2_arg.task);
+
+      str = mpn_srt_get_str (str, len - wlo, yhi, lo, tmp + m + lo->n, text);
+
+      get_str_sync (&thr2_arg.task);
+
+      str += wlo;
+    }
+
+  return str;
+}
+
+static void
+thr_srt_get_str (get_str_task_t *task)
+{
+  srt_get_str_t *data = (srt_get_str_t *) task;
+  mp_ptr tmp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * (get_str_srt_itch (data->powtab) + 1));
+
+  mpn_srt_get_str (data->str, data->len, data->yp, data->powtab, tmp, data->text);
+
+  free (tmp);
+  free (data->yp);
+}
+
+/* Convert {up,un} to a string by the scaled remainder tree, the powers at
+   powtab[0..pi-1] being cached squares, the top one above U.  The string
+   may have a leading zero.  */
+static unsigned char *
+get_str_srt (unsigned char *str, mp_ptr up, mp_size_t un,
+	     const get_str_powers_t *powtab, int pi, const char *text)
+{
+  const get_str_powers_t *pt = powtab + (pi - 1);
+  mp_size_t m, nn, qn;
+  mp_ptr np, qp, tmp;
+  size_t len;
+
+  /* The lowest power above U.  */
+  while (pt > powtab
+         && (un < (pt - 1)->n + (pt - 1)->shift
+             || (un == (pt - 1)->n + (pt - 1)->shift
+                 && mpn_cmp (up + (pt - 1)->shift, (pt - 1)->p, (pt - 1)->n) < 0)))
+    pt--;
+
+  /* y = U B^m / P, plus B^(m-n-1) as in mpn_srt_get_str.  */
+  m = GET_STR_FRAC_SIZE (pt);
+  nn = un + m - pt->shift;
+  qn = nn - pt->n + 1;
+  np = (mp_limb_t *) malloc (sizeof(mp_limb_t) * (nn + m + 1));
+  qp = np + nn;
+  MPN_ZERO (np, m - pt->shift);
+  MPN_COPY (np + m - pt->shift, up, un);
+  get_str_tdiv_qr (qp, np, np, nn, pt->p, pt->n, NULL, 0);
+  if (qn < m + 1)
+    MPN_ZERO (qp + qn, m + 1 - qn);
+  ASSERT (qp[m] == 0);
+  mpn_add_1 (qp + 2, qp + 2, m - 2, CNST_LIMB(1));
+
+  /* An estimate, exact or one too big, of which digits are not zero.  */
+  MPN_SIZEINBASE (len, up, un, pt->base);
+  for (; len > pt->digits_in_base; len--)
+    *str++ = text == NULL ? 0 : text[0];
+
+  tmp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * (get_str_srt_itch (pt) + 1));
+  str = mpn_srt_get_str (str, len, qp, pt, tmp, text);
+  free (tmp);
+  free (np);
+
+  return str;
+}
+
+typedef struct {
+  get_str_task_t task;
+  get_str_powers_t *pt; mp_limb_t big_base;
+} powtab_mul_1_t;
+
+/* Multiply the power at PT by big_base, the last step of its computation in
+   mpn_get_str.  */
+static void
+thr_powtab_mul_1 (get_str_task_t *task)
+{
+  powtab_mul_1_t *data = (powtab_mul_1_t *) task;
+  get_str_powers_t *pt = data->pt;
+  mp_ptr t = pt->p;
+  mp_size_t n = pt->n;
+  mp_limb_t cy;
+
+  cy = mpn_mul_1 (t, t, n, data->big_base);
+  t[n] = cy;
+  n += cy != 0;
+  if (t[0] == 0)
+    {
+      pt->p = t + 1;
+      n--;
+      pt->shift++;
+    }
+  pt->n = n;
+  pt->digits_in_base += mp_bases[pt->base].chars_per_limb;
+}
+
+#if ! defined(GET_STR_SERIAL)
+
+static pthread_mutex_t get_str_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+get_str_cache_lock (void)
+{
+  pthread_mutex_lock (&get_str_cache_mutex);
+}
+
+static void
+get_str_cache_unlock (void)
+{
+  pthread_mutex_unlock (&get_str_cache_mutex);
+}
+
+#else
+
+/* Without a lock, no cache.  */
+#undef GET_STR_CACHE_LIMIT
+#define GET_STR_CACHE_LIMIT  0
+
+static void get_str_cache_lock (void) { }
+static void get_str_cache_unlock (void) { }
+
+#endif
+
+/* Process-wide cache of power tables, shared by all mpn_get_str calls.  For
+   each base it holds the powers big_base^(2^i), level by level, computed on
+   demand and kept across calls, so that converting many numbers of similar
+   size builds the table only once.  A conversion holds a reference on the
+   table of its base while it runs.  Levels are only ever appended, and those
+   in use are not modified, so the lock is only held for bookkeeping.
+
+   The cache holds at most GET_STR_CACHE_LIMIT limbs.  A conversion needing
+   more computes its own table, as before.  Setting the limit to zero turns
+   the cache off.  */
+
+#ifndef GET_STR_CACHE_LIMIT
+#define GET_STR_CACHE_LIMIT  (1L << 24)	/* limbs */
+#endif
+
+typedef struct get_str_cache {
+  struct get_str_cache *next;
+  int base;
+  int users;			/* conversions, plus one while in the cache */
+  int cached;			/* in the list, until released */
+  int n;			/* levels computed */
+  get_str_powers_t pow[GMP_LIMB_BITS];
+  mp_ptr mem[GMP_LIMB_BITS];	/* allocated blocks, pow[i].p within */
+} get_str_cache_t;
+
+static get_str_cache_t *get_str_cache_list;
+static mp_size_t get_str_cache_limbs;
+
+void mpn_get_str_cache_warm (int, mp_size_t);
+void mpn_get_str_cache_release (void);
+
+static void
+get_str_cache_free (get_str_cache_t *c)
+{
+  int i;
+
+  for (i = 0; i < c->n; i++)
+    {
+      free (c->mem[i]);
+      free (c->pow[i].inv);
+    }
+  free (c);
+}
+
+/* Drop a reference taken by get_str_cache_get.  */
+static void
+get_str_cache_put (get_str_cache_t *c)
+{
+  int users;
+
+  get_str_cache_lock ();
+  users = --c->users;
+  get_str_cache_unlock ();
+
+  if (users == 0)
+    get_str_cache_free (c);
+}
+
+/* Fill powtab[0..*pi-1] with cached powers of base, enough to convert un
+   limbs, and return a reference on them.  Missing levels are computed
+   outside the lock; should another thread add the same level meanwhile, its
+   copy is kept.  Return NULL if the table would exceed the limit.  */
+static get_str_cache_t *
+get_str_cache_get (int base, mp_size_t un, get_str_powers_t *powtab, int *pi)
+{
+  get_str_cache_t *c;
+  mp_ptr mem, t;
+  mp_size_t n, shift;
+  int i, top, levels, full;
+
+  if (GET_STR_CACHE_LIMIT == 0)
+    return NULL;
+
+  get_str_cache_lock ();
+  for (c = get_str_cache_list; c != NULL; c = c->next)
+    if (c->base == base)
+      break;
+  if (c == NULL && (c = (get_str_cache_t *) malloc (sizeof(get_str_cache_t))) != NULL)
+    {
+      if ((c->mem[0] = (mp_limb_t *) malloc (sizeof(mp_limb_t))) == NULL)
+        {
+          free (c);
+          c = NULL;
+        }
+      else
+        {
+          c->mem[0][0] = mp_bases[base].big_base;
+          c->pow[0].p = c->mem[0];
+          c->pow[0].n = 1;
+          c->pow[0].shift = 0;
+          c->pow[0].digits_in_base = mp_bases[base].chars_per_limb;
+          c->pow[0].base = base;
+          c->pow[0].inv = NULL;
+          c->n = 1;
+          c->base = base;
+          c->users = 1;
+          c->cached = 1;
+          c->next = get_str_cache_list;
+          get_str_cache_list = c;
+          get_str_cache_limbs += 1;
+        }
+    }
+  if (c != NULL)
+    {
+      c->users++;
+      levels = c->n;
+    }
+  get_str_cache_unlock ();
+
+  if (c == NULL)
+    return NULL;
+
+  /* The top level is the first one whose square exceeds U.  Levels below
+     the count read under the lock are complete and do not change.  */
+  for (top = 0;; top++)
+    {
+      if (top == levels)
+        {
+          get_str_cache_lock ();
+          levels = c->n;
+          full = top == GMP_LIMB_BITS
+            || get_str_cache_limbs + 2 * c->pow[top - 1].n > GET_STR_CACHE_LIMIT;
+          get_str_cache_unlock ();
+        }
+      if (top == levels)
+        {
+          n = c->pow[top - 1].n;
+          shift = c->pow[top - 1].shift;
+
+          if (full || (mem = (mp_limb_t *) malloc (sizeof(mp_limb_t) * 2 * n)) == NULL)
+            {
+              get_str_cache_put (c);
+              return NULL;
+            }
+
+          get_str_mul (mem, c->pow[top - 1].p, n, c->pow[top - 1].p, n);
+          t = mem;
+          n = 2 * n;  n -= t[n - 1] == 0;
+          shift *= 2;
+          while (t[0] == 0)
+            {
+              t++;
+              n--;
+              shift++;
+            }
+
+          get_str_cache_lock ();
+          if (c->n == top)
+            {
+              c->mem[top] = mem;
+              c->pow[top].p = t;
+              c->pow[top].n = n;
+              c->pow[top].shift = shift;
+              c->pow[top].digits_in_base = 2 * c->pow[top - 1].digits_in_base;
+              c->pow[top].base = base;
+              c->pow[top].inv = NULL;
+              c->n = top + 1;
+              if (c->cached)
+                get_str_cache_limbs += 2 * c->pow[top - 1].n;
+              mem = NULL;
+            }
+          levels = c->n;
+          get_str_cache_unlock ();
+          free (mem);
+        }
+      if (2 * (c->pow[top].n + c->pow[top].shift) - 2 >= un)
+        break;
+    }
+
+  /* Under the lock, as reciprocals may be added meanwhile.  */
+  get_str_cache_lock ();
+  for (i = 0; i <= top; i++)
+    powtab[i] = c->pow[i];
+  get_str_cache_unlock ();
+  *pi = top + 1;
+
+  return c;
+}
+
+/* Compute the powers needed to convert numbers of up to un limbs in base,
+   ahead of the first conversion.  */
+void
+mpn_get_str_cache_warm (int base, mp_size_t un)
+{
+  get_str_powers_t powtab[GMP_LIMB_BITS];
+  get_str_cache_t *c;
+  int pi;
+
+  if (base < 3 || POW2_P (base))
+    return;
+  if ((c = get_str_cache_get (base, un, powtab, &pi)) != NULL)
+    get_str_cache_put (c);
+}
+
+/* Free the cached powers.  Tables still in use are freed by the last
+   conversion using them.  */
+void
+mpn_get_str_cache_release (void)
+{
+  get_str_cache_t *c, *next, *dead = NULL;
+
+  get_str_cache_lock ();
+  for (c = get_str_cache_list; c != NULL; c = next)
+    {
+      next = c->next;
+      c->cached = 0;
+      if (--c->users == 0)
+        {
+          c->next = dead;
+          dead = c;
+        }
+    }
+  get_str_cache_list = NULL;
+  get_str_cache_limbs = 0;
+  get_str_cache_unlock ();
+
+  for (c = dead; c != NULL; c = next)
+    {
+      next = c->next;
+      get_str_cache_free (c);
+    }
+}
+
+/* Conversion engines.  The default one divides by the powers.  The
+   reciprocal engine computes once, for each large power of the table, its
+   reciprocal to the precision needed for dividing numbers below its square,
+   and turns every division of the recursion into two multiplications and a
+   small correction, see get_str_tdiv_qr.  This pays off when a table is
+   used for many divisions: the reciprocals of cached powers are kept with
+   them, counted against GET_STR_CACHE_LIMIT, while those of a table computed
+   for a single call are freed after it, the top power having none.
+
+   The scaled remainder tree engine divides only once, see get_str_srt.  It
+   needs the cached squares, one level more than the others, else the
+   conversion is done by the default engine.
+
+   The engine defaults to the GET_STR_ENGINE environment variable, "div",
+   "inv" or "srt", see mpn_get_str_set_engine.  */
+
+#define GET_STR_ENGINE_DIV  0	/* divide by the powers */
+#define GET_STR_ENGINE_INV  1	/* multiply by reciprocals of the powers */
+#define GET_STR_ENGINE_SRT  2	/* scaled remainder tree */
+
+void mpn_get_str_set_engine (int);
+int mpn_get_str_get_engine (void);
+
+static const char *const get_str_engine_names[] = { "div", "inv", "srt" };
+
+static int get_str_engine = -1;	/* -1 until decided */
+
+/* Set the engine, one of GET_STR_ENGINE_*.  An unknown one selects the
+   default.  */
+void
+mpn_get_str_set_engine (int engine)
+{
+  if (engine < 0 || engine > GET_STR_ENGINE_SRT)
+    engine = GET_STR_ENGINE_DIV;
+  get_str_engine = engine;
+}
+
+int
+mpn_get_str_get_engine (void)
+{
+  if (get_str_engine < 0)
+    {
+      const char *env = getenv ("GET_STR_ENGINE");
+      int engine;
+
+      get_str_engine = GET_STR_ENGINE_DIV;
+      if (env != NULL)
+        for (engine = 0; engine <= GET_STR_ENGINE_SRT; engine++)
+          if (strcmp (env, get_str_engine_names[engine]) == 0)
+            get_str_engine = engine;
+    }
+
+  return get_str_engine;
+}
+
+/* Return the reciprocal of the power at pt to GET_STR_INV_SIZE(pt) limbs, in
+   a block of its own, or NULL if out of memory.  */
+static mp_ptr
+get_str_inv_alloc (const get_str_powers_t *pt)
+{
+  mp_size_t k = GET_STR_INV_SIZE (pt);
+  mp_ptr ip, tp;
+
+  ip = (mp_limb_t *) malloc (sizeof(mp_limb_t) * (k + 2));
+  tp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * k);
+  if (ip != NULL && tp != NULL)
+    {
+      MPN_ZERO (tp, k - pt->n);
+      MPN_COPY (tp + k - pt->n, pt->p, pt->n);
+      get_str_invert (ip, tp, k);
+    }
+  else
+    {
+      free (ip);
+      ip = NULL;
+    }
+  free (tp);
+
+  return ip;
+}
+
+/* With the reciprocal engine, give the powers at powtab[0..pi-1] of at
+   least GET_STR_INV_THRESHOLD limbs their reciprocals, taken from the cache
+   c or added to it.  Without a cache, they are computed for this call and
+   freed by get_str_inv_free.  With another engine, give none.  */
+static void
+get_str_inv_get (get_str_powers_t *powtab, int pi, get_str_cache_t *c)
+{
+  mp_ptr ip;
+  mp_size_t size;
+  int i, full;
+
+  if (mpn_get_str_get_engine () != GET_STR_ENGINE_INV)
+    {
+      for (i = 0; i < pi; i++)
+        powtab[i].inv = NULL;
+      return;
+    }
+
+  for (i = 0; i < pi; i++)
+    {
+      if (powtab[i].n < GET_STR_INV_THRESHOLD || powtab[i].inv != NULL)
+        continue;
+
+      if (c == NULL)
+        {
+          if (i < pi - 1)
+            powtab[i].inv = get_str_inv_alloc (&powtab[i]);
+          continue;
+        }
+
+      size = GET_STR_INV_SIZE (&powtab[i]) + 2;
+
+      get_str_cache_lock ();
+      ip = c->pow[i].inv;
+      full = get_str_cache_limbs + size > GET_STR_CACHE_LIMIT;
+      get_str_cache_unlock ();
+
+      if (ip == NULL && ! full && (ip = get_str_inv_alloc (&powtab[i])) != NULL)
+        {
+          /* Should another thread add it meanwhile, its copy is kept.  */
+          get_str_cache_lock ();
+          if (c->pow[i].inv == NULL)
+            {
+              c->pow[i].inv = ip;
+              if (c->cached)
+                get_str_cache_limbs += size;
+              ip = NULL;
+            }
+          get_str_cache_unlock ();
+          free (ip);
+          ip = c->pow[i].inv;
+        }
+      powtab[i].inv = ip;
+    }
+}
+
+/* Free the reciprocals computed for a table without cache.  */
+static void
+get_str_inv_free (get_str_powers_t *powtab, int pi)
+{
+  int i;
+
+  for (i = 0; i < pi; i++)
+    free (powtab[i].inv);
+}
+
+
+/* There are no leading zeros on the digits generated at str, but that's not
+   currently a documented feature.  The current mpz_out_str and mpz_get_str
+   rely on it.  */
+
+/* Like mpn_get_str, but write the digits as characters of num_to_text,
+   which saves a pass over the string to translate them.  */
+size_t
+mpn_get_str_text (unsigned char *str, int base, mp_ptr up, mp_size_t un,
+		  const char *num_to_text)
+{
+  mp_ptr powtab_mem, powtab_mem_ptr;
+  mp_limb_t big_base;
+  size_t digits_in_base;
+  get_str_powers_t powtab[GMP_LIMB_BITS];
+  int pi;
+  mp_size_t n;
+  mp_ptr p, t;
+  size_t out_len;
+  mp_ptr tmp;
+  mp_size_t tn;
+  get_str_cache_t *cache;
+  unsigned char zero;
+  int d, srt;
+  TMP_DECL;
+
+  /* Special case zero, as the code below doesn't handle it.  */
+  if (un == 0)
+    {
+      str[0] = num_to_text == NULL ? 0 : num_to_text[0];
+      return 1;
+    }
+
+  if (POW2_P (base))
+    {
+      /* The base is a power of 2.  Convert from most significant end.  */
+      mp_limb_t n1, n0;
+      int bits_per_digit = mp_bases[base].big_base;
+      int cnt;
+      int bit_pos;
+      mp_size_t i;
+      unsigned char *s = str;
+      mp_bitcnt_t bits;
+
+      n1 = up[un - 1];
+      count_leading_zeros (cnt, n1);
+
+      /* BIT_POS should be R when input ends in least significant nibble,
+	 R + bits_per_digit * n when input ends in nth least significant
+	 nibble. */
+
+      bits = (mp_bitcnt_t) GMP_NUMB_BITS * un - cnt + GMP_NAIL_BITS;
+      cnt = bits % bits_per_digit;
+      if (cnt != 0)
+	bits += bits_per_digit - cnt;
+      bit_pos = bits - (mp_bitcnt_t) (un - 1) * GMP_NUMB_BITS;
+
+      /* Fast loop for bit output.  */
+      i = un - 1;
+      for (;;)
+	{
+	  bit_pos -= bits_per_digit;
+	  while (bit_pos >= 0)
+	    {
+	      *s++ = (n1 >> bit_pos) & ((1 << bits_per_digit) - 1);
+	      bit_pos -= bits_per_digit;
+	    }
+	  i--;
+	  if (i < 0)
+	    break;
+	  n0 = (n1 << -bit_pos) & ((1 << bits_per_digit) - 1);
+	  n1 = up[i];
+	  bit_pos += GMP_NUMB_BITS;
+	  *s++ = n0 | (n1 >> bit_pos);
+	}
+
+      if (num_to_text != NULL)
+	for (i = 0; i < s - str; i++)
+	  str[i] = num_to_text[str[i]];
+
+      return s - str;
+    }
+
+  /* General case.  The base is not a power of 2.  */
+
+  if (BELOW_THRESHOLD (un, GET_STR_PRECOMPUTE_THRESHOLD))
+    return mpn_sb_get_str (str, (size_t) 0, up, un, base, num_to_text) - str;
+
+  TMP_MARK;
+
+  /* Take the powers from the cache, else compute a table for this call.
+     The scaled remainder tree wants a power above U, not its square root.  */
+  srt = mpn_get_str_get_engine () == GET_STR_ENGINE_SRT;
+  cache = get_str_cache_get (base, srt ? 2 * un : un, powtab, &pi);
+  if (cache == NULL)
+  {
+    mp_size_t n_pows, xn, pn, exptab[GMP_LIMB_BITS], bexp;
+    mp_limb_t cy, spawned = 0;
+    mp_size_t shift;
+    powtab_mul_1_t fixup[GMP_LIMB_BITS];
+    size_t ndig;
+
+    /* Allocate one large block for the powers of big_base.  */
+    powtab_mem = TMP_BALLOC_LIMBS (mpn_dc_get_str_powtab_alloc (un));
+    powtab_mem_ptr = powtab_mem;
+
+    /* Compute a table of powers, were the largest power is >= sqrt(U).  */
+
+    big_base = mp_bases[base].big_base;
+    digits_in_base = mp_bases[base].chars_per_limb;
+
+    DIGITS_IN_BASE_PER_LIMB (ndig, un, base);
+    xn = 1 + ndig / mp_bases[base].chars_per_limb; /* FIXME: scalar integer division */
+
+    n_pows = 0;
+    for (pn = xn; pn != 1; pn = (pn + 1) >> 1)
+      {
+	exptab[n_pows] = pn;
+	n_pows++;
+      }
+    exptab[n_pows] = 1;
+
+    powtab[0].p = &big_base;
+    powtab[0].n = 1;
+    powtab[0].digits_in_base = digits_in_base;
+    powtab[0].base = base;
+    powtab[0].shift = 0;
+    powtab[0].inv = NULL;
+
+    powtab[1].p = powtab_mem_ptr;  powtab_mem_ptr += 2;
+    powtab[1].p[0] = big_base;
+    powtab[1].n = 1;
+    powtab[1].digits_in_base = digits_in_base;
+    powtab[1].base = base;
+    powtab[1].shift = 0;
+    powtab[1].inv = NULL;
+
+    n = 1;
+    p = &big_base;
+    bexp = 1;
+    shift = 0;
+    for (pi = 2; pi < n_pows; pi++)
+      {
+	t = powtab_mem_ptr;
+	powtab_mem_ptr += 2 * n + 2;
+
+	ASSERT_ALWAYS (powtab_mem_ptr < powtab_mem + mpn_dc_get_str_powtab_alloc (un));
+
+	get_str_mul (t, p, n, p, n);
+
+	digits_in_base *= 2;
+	n *= 2;  n -= t[n - 1] == 0;
 	bexp *= 2;
 
 	if (bexp + 1 < exptab[n_pows - pi])
@@ -600,24 +2450,26 @@ mpn_get_str (unsigned char *str, int base, mp_ptr up, mp_size_t un)
 	powtab[pi].digits_in_base = digits_in_base;
 	powtab[pi].base = base;
 	powtab[pi].shift = shift;
+	powtab[pi].inv = NULL;
       }
 
+    /* The entries are independent here, the large ones are done as tasks.  */
     for (pi = 1; pi < n_pows; pi++)
       {
-	t = powtab[pi].p;
-	n = powtab[pi].n;
-	cy = mpn_mul_1 (t, t, n, big_base);
-	t[n] = cy;
-	n += cy != 0;
-	if (t[0] == 0)
+	fixup[pi].pt = &powtab[pi];
+	fixup[pi].big_base = big_base;
+	fixup[pi].task.func = thr_powtab_mul_1;
+	if (powtab[pi].n < GET_STR_MUL_THRESHOLD || ! get_str_idle ())
+	  thr_powtab_mul_1 (&fixup[pi].task);
+	else
 	  {
-	    powtab[pi].p = t + 1;
-	    n--;
-	    powtab[pi].shift++;
+	    get_str_spawn (&fixup[pi].task);
+	    spawned |= (mp_limb_t) 1 << pi;
 	  }
-	powtab[pi].n = n;
-	powtab[pi].digits_in_base += mp_bases[base].chars_per_limb;
       }
+    for (pi = 1; pi < n_pows; pi++)
+      if ((spawned >> pi) & 1)
+	get_str_sync (&fixup[pi].task);
 
 #if 0
     { int i;
@@ -628,10 +2480,639 @@ mpn_get_str (unsigned char *str, int base, mp_ptr up, mp_size_t un)
 #endif
   }
 
+  get_str_inv_get (powtab, pi, cache);
+
   /* Using our precomputed powers, now in powtab[], convert our number.  */
-  tmp = TMP_BALLOC_LIMBS (mpn_dc_get_str_itch (un));
-  out_len = mpn_dc_get_str (str, 0, up, un, powtab + (pi - 1), tmp, 1) - str;
+  if (cache != NULL && srt)
+    out_len = get_str_srt (str, up, un, powtab, pi, num_to_text) - str;
+  else if (cache != NULL && (d = get_str_split_depth (powtab, pi - 1)) != 0)
+    out_len = mpn_split_get_str (str, 0, up, un, powtab + (pi - 1), d, num_to_text) - str;
+  else
+    {
+      tn = get_str_dc_itch (un);
+      tmp = TMP_BALLOC_LIMBS (tn);
+      out_len = mpn_dc_get_str (str, 0, up, un, powtab + (pi - 1), tmp, tn, num_to_text) - str;
+    }
+  if (cache != NULL)
+    get_str_cache_put (cache);
+  else
+    get_str_inv_free (powtab, pi);
   TMP_FREE;
 
+  /* A parallel split of the leftmost part may leave a leading zero.  */
+  zero = num_to_text == NULL ? 0 : num_to_text[0];
+  if (str[0] == zero)
+    {
+      size_t zeros = 1;
+      while (str[zeros] == zero)
+        zeros++;
+      out_len -= zeros;
+      memmove (str, str + zeros, out_len);
+    }
+
   return out_len;
 }
+
+size_t
+mpn_get_str (unsigned char *str, int base, mp_ptr up, mp_size_t un)
+{
+  return mpn_get_str_text (str, base, up, un, NULL);
+}
+
+/* Streaming conversion.  The number is cut from the left in pieces below
+   the square of a cached power, converted one at a time in full parallel,
+   and each piece is handed to the caller while the next one is converted.
+   Only two pieces of GET_STR_STREAM_CHUNK characters at most are buffered,
+   not the whole string.  Numbers too small for the power table cache, or too
+   large for it, are converted in one string as usual.  */
+
+#ifndef GET_STR_STREAM_CHUNK
+#define GET_STR_STREAM_CHUNK  (1L << 22)	/* characters */
+#endif
+
+typedef size_t (*get_str_write_t) (void *, unsigned char *, size_t);
+
+size_t mpn_get_str_stream (int, mp_ptr, mp_size_t, get_str_write_t, void *,
+			   const char *);
+
+typedef struct {
+  get_str_task_t task;		/* writes the previous piece */
+  unsigned char *buf[2]; int cur;
+  unsigned char *wstr; size_t wlen;
+  const get_str_powers_t *powtab;	/* the bottom of the table */
+  const get_str_powers_t *piece;	/* pieces are below the square of this */
+  get_str_write_t write; void *arg;
+  const char *text;
+  size_t written;
+} get_str_stream_t;
+
+static void
+thr_get_str_stream_write (get_str_task_t *task)
+{
+  get_str_stream_t *s = (get_str_stream_t *) task;
+
+  s->written += s->write (s->arg, s->wstr, s->wlen);
+}
+
+/* Convert a piece to len characters, or as many as required if len is zero,
+   while the previous piece is written.  */
+static void
+get_str_stream_piece (get_str_stream_t *s, mp_ptr up, mp_size_t un,
+		      const get_str_powers_t *powtab, size_t len)
+{
+  unsigned char *str = s->buf[s->cur], *end;
+  int d = 0, pending = s->wlen != 0;
+  mp_ptr tmp;
+  mp_size_t tn;
+
+  if (pending)
+    {
+      s->task.func = thr_get_str_stream_write;
+      get_str_spawn (&s->task);
+    }
+
+  if (get_str_parallel ())
+    while ((1 << d) < mpn_get_str_get_threads () && powtab - d > s->powtab)
+      d++;
+
+  if (d != 0)
+    end = mpn_split_get_str (str, len, up, un, powtab, d, s->text);
+  else
+    {
+      tn = get_str_dc_itch (un);
+      tmp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * tn);
+      end = mpn_dc_get_str (str, len, up, un, powtab, tmp, tn, s->text);
+      free (tmp);
+    }
+
+  if (pending)
+    get_str_sync (&s->task);
+
+  s->wstr = str;
+  s->wlen = end - str;
+  s->cur ^= 1;
+
+  /* The leftmost piece may start with a zero, as in mpn_get_str.  */
+  if (len == 0)
+    while (*s->wstr == (s->text == NULL ? 0 : s->text[0]))
+      {
+        s->wstr++;
+        s->wlen--;
+      }
+}
+
+/* Convert {up,un}, which is below the square of the power at powtab, from
+   the left like mpn_dc_get_str, down to pieces.  */
+static void
+get_str_stream_node (get_str_stream_t *s, mp_ptr up, mp_size_t un,
+		     const get_str_powers_t *powtab, size_t len)
+{
+  mp_ptr pwp = powtab->p, qp;
+  mp_size_t pwn = powtab->n, sn = powtab->shift, qn;
+
+  if (powtab <= s->piece)
+    {
+      get_str_stream_piece (s, up, un, powtab, len);
+    }
+  else if (un < pwn + sn || (un == pwn + sn && mpn_cmp (up + sn, pwp, un - sn) < 0))
+    {
+      get_str_stream_node (s, up, un, powtab - 1, len);
+    }
+  else
+    {
+      qn = un - sn - pwn + 1;
+      qp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * qn);
+      get_str_tdiv_qr (qp, up + sn, up + sn, un - sn, pwp, pwn,
+                       powtab->inv, GET_STR_INV_SIZE (powtab));
+      while (qp[qn - 1] == 0)
+        qn--;
+      un = pwn + sn;
+      while (un > 0 && up[un - 1] == 0)
+        un--;
+
+      get_str_stream_node (s, qp, qn, powtab - 1,
+                           len == 0 ? 0 : len - powtab->digits_in_base);
+      free (qp);
+      get_str_stream_node (s, up, un, powtab - 1, powtab->digits_in_base);
+    }
+}
+
+/* Convert {up,un} like mpn_get_str, but hand the characters to write, in
+   pieces from left to right, instead of putting them in one string.  write
+   gets arg, a piece and its length, and returns the number of characters
+   written.  Return the sum of those.  The digits are characters of
+   num_to_text, or their values if it is NULL.  */
+size_t
+mpn_get_str_stream (int base, mp_ptr up, mp_size_t un,
+		    get_str_write_t write, void *arg, const char *num_to_text)
+{
+  get_str_stream_t s;
+  get_str_powers_t powtab[GMP_LIMB_BITS];
+  get_str_cache_t *cache = NULL;
+  unsigned char *str;
+  size_t len;
+  int pi;
+
+  if (un != 0 && ! POW2_P (base) && ! BELOW_THRESHOLD (un, GET_STR_PRECOMPUTE_THRESHOLD))
+    cache = get_str_cache_get (base, un, powtab, &pi);
+
+  if (cache == NULL)
+    {
+      if (un == 0)
+        len = 1;
+      else
+        MPN_SIZEINBASE (len, up, un, base);
+      str = (unsigned char *) malloc (len + 1);
+      len = mpn_get_str_text (str, base, up, un, num_to_text);
+      len = write (arg, str, len);
+      free (str);
+      return len;
+    }
+
+  get_str_inv_get (powtab, pi, cache);
+
+  /* Pieces are below the square of the largest power giving at most
+     GET_STR_STREAM_CHUNK characters, else of the lowest one.  */
+  s.powtab = powtab;
+  s.piece = powtab;
+  while (s.piece < powtab + pi - 1
+         && 2 * (s.piece + 1)->digits_in_base <= GET_STR_STREAM_CHUNK)
+    s.piece++;
+
+  len = 2 * s.piece->digits_in_base + 1;
+  s.buf[0] = (unsigned char *) malloc (2 * len);
+  s.buf[1] = s.buf[0] + len;
+  s.cur = 0;
+  s.wlen = 0;
+  s.write = write;
+  s.arg = arg;
+  s.text = num_to_text;
+  s.written = 0;
+
+  get_str_stream_node (&s, up, un, powtab + (pi - 1), 0);
+  thr_get_str_stream_write (&s.task);
+
+  free (s.buf[0]);
+  get_str_cache_put (cache);
+
+  return s.written;
+}
+
+/* Digit windows.  The characters from position start to start+len-1 of a
+   number, counted from the right, are floor(U / base^start) mod base^len.
+   They are found by dividing down the tree of cached powers as
+   mpn_dc_get_str does, but only into the parts covering the window, so that
+   the divisions along one or two paths are done, and only the digits inside
+   the window are converted.  */
+
+size_t mpn_get_str_window (unsigned char *, int, mp_ptr, mp_size_t,
+			   size_t, size_t, const char *);
+
+/* Put in str the characters start to start+len-1, counted from the right, of
+   {up,un}, which is below the square of the power at powtab and has at most
+   width characters.  */
+static void
+get_str_window_node (unsigned char *str, mp_ptr up, mp_size_t un,
+		     const get_str_powers_t *powtab, size_t width,
+		     size_t start, size_t len, const char *text)
+{
+  mp_ptr pwp = powtab->p, qp, tmp;
+  mp_size_t pwn = powtab->n, sn = powtab->shift, qn, tn;
+  size_t d = powtab->digits_in_base, n;
+  unsigned char *buf;
+
+  if (BELOW_THRESHOLD (un, GET_STR_DC_THRESHOLD))
+    {
+      if (un == 0)
+        n = 0;
+      else
+        MPN_SIZEINBASE (n, up, un, powtab->base);
+      if (n < width)
+        width = n;
+    }
+
+  /* Characters above the number are zeros.  */
+  if (start + len > width)
+    {
+      n = start >= width ? len : start + len - width;
+      memset (str, text == NULL ? 0 : text[0], n);
+      str += n;
+      len -= n;
+    }
+  if (len == 0)
+    return;
+
+  if (start == 0 && len == width)
+    {
+      tn = get_str_dc_itch (un);
+      tmp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * tn);
+      mpn_dc_get_str (str, width, up, un, powtab, tmp, tn, text);
+      free (tmp);
+    }
+  else if (BELOW_THRESHOLD (un, GET_STR_DC_THRESHOLD))
+    {
+      buf = (unsigned char *) malloc (width);
+      mpn_sb_get_str (buf, width, up, un, powtab->base, text);
+      memcpy (str, buf + (width - start - len), len);
+      free (buf);
+    }
+  else if (un < pwn + sn || (un == pwn + sn && mpn_cmp (up + sn, pwp, un - sn) < 0))
+    {
+      get_str_window_node (str, up, un, powtab - 1, width, start, len, text);
+    }
+  else
+    {
+      /* The remainder holds the low d characters, the quotient the rest.  */
+      qn = un - sn - pwn + 1;
+      qp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * qn);
+      get_str_tdiv_qr (qp, up + sn, up + sn, un - sn, pwp, pwn,
+                       powtab->inv, GET_STR_INV_SIZE (powtab));
+      while (qp[qn - 1] == 0)
+        qn--;
+      un = pwn + sn;
+      while (un > 0 && up[un - 1] == 0)
+        un--;
+
+      n = 0;
+      if (start + len > d)
+        {
+          n = start > d ? len : start + len - d;
+          get_str_window_node (str, qp, qn, powtab - 1, width - d,
+                               start > d ? start - d : 0, n, text);
+        }
+      free (qp);
+      if (start < d)
+        get_str_window_node (str + n, up, un, powtab - 1, d,
+                             start, len - n, text);
+    }
+}
+
+/* Put in str the characters start to start+len-1 of {up,un}, counted from
+   the right from zero, that is floor(U / base^start) mod base^len written
+   with len characters, padded with zeros to the left.  {up,un} is destroyed,
+   as by mpn_get_str.  Return len.  The digits are characters of num_to_text,
+   or their values if it is NULL.  Numbers too small for the power table
+   cache, or too large for it, are converted in full.  */
+size_t
+mpn_get_str_window (unsigned char *str, int base, mp_ptr up, mp_size_t un,
+		    size_t start, size_t len, const char *num_to_text)
+{
+  get_str_powers_t powtab[GMP_LIMB_BITS];
+  get_str_cache_t *cache = NULL;
+  unsigned char *buf;
+  size_t width, n;
+  int pi;
+
+  if (un == 0)
+    width = 1;
+  else
+    MPN_SIZEINBASE (width, up, un, base);
+
+  if (un != 0 && ! POW2_P (base) && ! BELOW_THRESHOLD (un, GET_STR_PRECOMPUTE_THRESHOLD))
+    cache = get_str_cache_get (base, un, powtab, &pi);
+
+  if (cache == NULL)
+    {
+      buf = (unsigned char *) malloc (width + 1);
+      width = mpn_get_str_text (buf, base, up, un, num_to_text);
+      n = start >= width ? 0 : start + len > width ? width - start : len;
+      memset (str, num_to_text == NULL ? 0 : num_to_text[0], len - n);
+      if (n != 0)
+        memcpy (str + (len - n), buf + (width - start - n), n);
+      free (buf);
+      return len;
+    }
+
+  get_str_inv_get (powtab, pi, cache);
+  get_str_window_node (str, up, un, powtab + (pi - 1), width, start, len, num_to_text);
+  get_str_cache_put (cache);
+
+  return len;
+}
+
+/* Parallel mpn_set_str.  The digits are split at the power of the table
+   nearest below their count, as mpn_dc_get_str divides, and the value of
+   the high part times the power plus the value of the low part gives the
+   result.  The high and low parts are converted at the same time, and the
+   products are split in parts by get_str_mul, so the whole multiply tree
+   runs on the pool.  The powers come from the power table cache.
+
+   This is only for a program including this file.  Built as mpn/get_str.c
+   within the library, mpn/generic/set_str.c provides mpn_set_str.  */
+
+#if ! defined (__GMP_WITHIN_GMP)
+
+#ifndef SET_STR_DC_THRESHOLD
+#define SET_STR_DC_THRESHOLD  750	/* limbs */
+#endif
+
+/* Limbs enough for the value of n digits, and for the products making it
+   up, which are one limb longer than the value at most.  */
+#define SET_STR_LIMBS(n, b)  ((n) / mp_bases[b].chars_per_limb + 2)
+
+typedef struct {
+  get_str_task_t task;
+  mp_ptr rp; mp_size_t rn;
+  const unsigned char *str; size_t len;
+  const get_str_powers_t *powtab;
+} dc_set_str_t;
+
+/* Put in {rp,rn} the value of the len digits at str, most significant
+   first, and return rn.  Complexity is O(len^2); intended for small
+   conversions.  */
+static mp_size_t
+get_str_bc_set_str (mp_ptr rp, const unsigned char *str, size_t len, int base)
+{
+  mp_size_t size;
+  size_t i;
+  long j;
+  mp_limb_t cy_limb, big_base, res_digit;
+  int chars_per_limb;
+
+  big_base = mp_bases[base].big_base;
+  chars_per_limb = mp_bases[base].chars_per_limb;
+
+  size = 0;
+  for (i = chars_per_limb; i < len; i += chars_per_limb)
+    {
+      res_digit = *str++;
+      if (base == 10)
+	{ /* This is a common case.
+	     Help the compiler to avoid multiplication.  */
+	  for (j = MP_BASES_CHARS_PER_LIMB_10 - 1; j != 0; j--)
+	    res_digit = res_digit * 10 + *str++;
+	}
+      else
+	{
+	  for (j = chars_per_limb - 1; j != 0; j--)
+	    res_digit = res_digit * base + *str++;
+	}
+
+      if (size == 0)
+	{
+	  if (res_digit != 0)
+	    {
+	      rp[0] = res_digit;
+	      size = 1;
+	    }
+	}
+      else
+	{
+	  cy_limb = mpn_mul_1 (rp, rp, size, big_base);
+	  cy_limb += mpn_add_1 (rp, rp, size, res_digit);
+	  if (cy_limb != 0)
+	    rp[size++] = cy_limb;
+	}
+    }
+
+  big_base = base;
+  res_digit = *str++;
+  for (j = len - (i - chars_per_limb) - 1; j > 0; j--)
+    {
+      res_digit = res_digit * base + *str++;
+      big_base *= base;
+    }
+
+  if (size == 0)
+    {
+      if (res_digit != 0)
+	{
+	  rp[0] = res_digit;
+	  size = 1;
+	}
+    }
+  else
+    {
+      cy_limb = mpn_mul_1 (rp, rp, size, big_base);
+      cy_limb += mpn_add_1 (rp, rp, size, res_digit);
+      if (cy_limb != 0)
+	rp[size++] = cy_limb;
+    }
+  return size;
+}
+
+static void thr_dc_set_str (get_str_task_t *task);
+
+/* Put in rp the value of the len digits at str, using the powers at powtab
+   and below, and return its size.  rp has room for SET_STR_LIMBS(len)
+   limbs.  This uses divide-and-conquer and is intended for large
+   conversions, of SET_STR_DC_THRESHOLD limbs and up.  */
+static mp_size_t
+get_str_dc_set_str (mp_ptr rp, const unsigned char *str, size_t len,
+		const get_str_powers_t *powtab)
+{
+  mp_ptr pwp, tp, pp;
+  mp_size_t pwn, sn, hn, ln, rn;
+  size_t d;
+  int base = powtab->base, spawn;
+  dc_set_str_t hi;
+
+  while (powtab->digits_in_base >= len)
+    powtab--;
+
+  pwp = powtab->p;
+  pwn = powtab->n;
+  sn = powtab->shift;
+  d = powtab->digits_in_base;
+
+  /* The high len-d digits go to tp, the low d digits to rp.  */
+  tp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * SET_STR_LIMBS (len - d, base));
+
+  hi.rp     = tp;
+  hi.str    = str;
+  hi.len    = len - d;
+  hi.powtab = powtab;
+  hi.task.func = thr_dc_set_str;
+
+  /* Spawn the high part when it is enough work to pay off.  */
+  spawn = len - d >= GET_STR_THREAD_THRESHOLD && get_str_parallel ();
+  if (spawn)
+    get_str_spawn (&hi.task);
+  else
+    thr_dc_set_str (&hi.task);
+
+  if (d < SET_STR_DC_THRESHOLD * (size_t) mp_bases[base].chars_per_limb)
+    ln = get_str_bc_set_str (rp, str + (len - d), d, base);
+  else
+    ln = get_str_dc_set_str (rp, str + (len - d), d, powtab - 1);
+
+  if (spawn)
+    get_str_sync (&hi.task);
+  hn = hi.rn;
+
+  if (hn == 0)
+    {
+      free (tp);
+      return ln;
+    }
+
+  /* rp = high * power + low, where low is below the power.  */
+  pp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * (hn + pwn));
+  if (hn >= pwn)
+    get_str_mul (pp, tp, hn, pwp, pwn);
+  else
+    get_str_mul (pp, pwp, pwn, tp, hn);
+  free (tp);
+
+  rn = hn + pwn + sn;
+  MPN_ZERO (rp + ln, rn - ln);
+  mpn_add_n (rp + sn, rp + sn, pp, hn + pwn);
+  free (pp);
+
+  while (rp[rn - 1] == 0)
+    rn--;
+  return rn;
+}
+
+static void
+thr_dc_set_str (get_str_task_t *task)
+{
+  dc_set_str_t *data = (dc_set_str_t *) task;
+  int base = data->powtab->base;
+
+  if (data->len < SET_STR_DC_THRESHOLD * (size_t) mp_bases[base].chars_per_limb)
+    data->rn = get_str_bc_set_str (data->rp, data->str, data->len, base);
+  else
+    data->rn = get_str_dc_set_str (data->rp, data->str, data->len, data->powtab);
+}
+
+/* Put in {rp,rn} the value of the len digits at str in base, most
+   significant first, and return rn, as GMP's mpn_set_str.  Large inputs go
+   through get_str_dc_set_str with the cached powers, or with powers computed
+   here when the cache cannot take them.  */
+mp_size_t
+mpn_set_str (mp_ptr rp, const unsigned char *str, size_t len, int base)
+{
+  get_str_powers_t powtab[GMP_LIMB_BITS];
+  get_str_cache_t *cache = NULL;
+  mp_ptr mem[GMP_LIMB_BITS], tp, t;
+  mp_size_t rn, un, n, shift;
+  int pi, i;
+
+  if (POW2_P (base))
+    {
+      /* The base is a power of 2.  Read the input string from least to most
+	 significant character/digit.  */
+      const unsigned char *s;
+      int next_bitpos;
+      mp_limb_t res_digit;
+      mp_size_t size;
+      int bits_per_indigit = mp_bases[base].big_base;
+
+      size = 0;
+      res_digit = 0;
+      next_bitpos = 0;
+
+      for (s = str + len - 1; s >= str; s--)
+	{
+	  int inp_digit = *s;
+
+	  res_digit |= ((mp_limb_t) inp_digit << next_bitpos) & GMP_NUMB_MASK;
+	  next_bitpos += bits_per_indigit;
+	  if (next_bitpos >= GMP_NUMB_BITS)
+	    {
+	      rp[size++] = res_digit;
+	      next_bitpos -= GMP_NUMB_BITS;
+	      res_digit = inp_digit >> (bits_per_indigit - next_bitpos);
+	    }
+	}
+
+      if (res_digit != 0)
+	rp[size++] = res_digit;
+      return size;
+    }
+
+  if (len < SET_STR_DC_THRESHOLD * (size_t) mp_bases[base].chars_per_limb)
+    return get_str_bc_set_str (rp, str, len, base);
+
+  un = SET_STR_LIMBS (len, base);
+  if ((cache = get_str_cache_get (base, un, powtab, &pi)) == NULL)
+    {
+      /* Square the big base up to half the digits, as the cache does.  */
+      mem[0] = (mp_limb_t *) malloc (sizeof(mp_limb_t));
+      mem[0][0] = mp_bases[base].big_base;
+      powtab[0].p = mem[0];
+      powtab[0].n = 1;
+      powtab[0].shift = 0;
+      powtab[0].digits_in_base = mp_bases[base].chars_per_limb;
+      powtab[0].base = base;
+      powtab[0].inv = NULL;
+      for (pi = 1; 2 * powtab[pi - 1].digits_in_base < len; pi++)
+        {
+          n = powtab[pi - 1].n;
+          shift = powtab[pi - 1].shift;
+          t = mem[pi] = (mp_limb_t *) malloc (sizeof(mp_limb_t) * 2 * n);
+          get_str_mul (t, powtab[pi - 1].p, n, powtab[pi - 1].p, n);
+          n = 2 * n;  n -= t[n - 1] == 0;
+          shift *= 2;
+          while (t[0] == 0)
+            {
+              t++;
+              n--;
+              shift++;
+            }
+          powtab[pi].p = t;
+          powtab[pi].n = n;
+          powtab[pi].shift = shift;
+          powtab[pi].digits_in_base = 2 * powtab[pi - 1].digits_in_base;
+          powtab[pi].base = base;
+          powtab[pi].inv = NULL;
+        }
+    }
+
+  /* The products may take a limb more than rp has room for.  */
+  tp = (mp_limb_t *) malloc (sizeof(mp_limb_t) * un);
+  rn = get_str_dc_set_str (tp, str, len, powtab + (pi - 1));
+  MPN_COPY (rp, tp, rn);
+  free (tp);
+
+  if (cache != NULL)
+    get_str_cache_put (cache);
+  else
+    for (i = 0; i < pi; i++)
+      free (mem[i]);
+
+  return rn;
+}
+
+#endif /* ! __GMP_WITHIN_GMP */
@@ -47,7 +47,6 @@ mpz_get_str (char *res_str, int base, mpz_srcptr x)
   size_t str_size;
   size_t alloc_size = 0;
   const char *num_to_text;
-  int i;
   TMP_DECL;
 
   if (base >= 0)
@@ -97,12 +96,9 @@ mpz_get_str (char *res_str, int base, mpz_srcptr x)
       MPN_COPY (xp, PTR (x), x_size);
     }
 
-  str_size = mpn_get_str ((unsigned char *) res_str, base, xp, x_size);
+  str_size = mpn_get_str_text ((unsigned char *) res_str, base, xp, x_size,
+			       num_to_text);
   ASSERT (alloc_size == 0 || str_size <= alloc_size - (SIZ(x) < 0));
-
-  /* Convert result to printable chars.  */
-  for (i = 0; i < str_size; i++)
-    res_str[i] = num_to_text[(int) res_str[i]];
   res_str[str_size] = 0;
 
   TMP_FREE;
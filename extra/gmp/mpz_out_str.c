@@ -31,62 +31,103 @@ GNU Lesser General Public License along with the GNU MP Library.  If not,
 see https://www.gnu.org/licenses/.  */
 
 #include <stdio.h>
+#include <unistd.h>
 #include "gmp.h"
 #include "gmp-impl.h"
 #include "longlong.h"
 
-size_t
-mpz_out_str (FILE *stream, int base, mpz_srcptr x)
+/* The digits are produced in pieces by mpn_get_str_stream, as printable
+   chars, each written while the next one is converted, to a stream or else
+   to a file descriptor.  */
+typedef struct {
+  FILE *stream;
+  int fd;
+  const char *num_to_text;
+  int failed;
+} out_str_t;
+
+static size_t
+out_str_write (void *arg, unsigned char *str, size_t len)
 {
-  mp_ptr xp;
-  mp_size_t x_size = SIZ (x);
-  unsigned char *str;
-  size_t str_size;
-  size_t i;
+  out_str_t *out = (out_str_t *) arg;
   size_t written;
-  const char *num_to_text;
-  TMP_DECL;
+  ssize_t ret;
+
+  if (out->stream != NULL)
+    return fwrite ((char *) str, 1, len, out->stream);
+
+  for (written = 0; written < len; written += ret)
+    if ((ret = write (out->fd, str + written, len - written)) <= 0)
+      {
+	out->failed = 1;
+	break;
+      }
+  return written;
+}
 
-  if (stream == 0)
-    stream = stdout;
+/* The digit characters for base, as mpz_get_str uses them, with *base made
+   positive and 0 or 1 taken as 10, or NULL if base is out of range.  */
+static const char *
+out_str_digits (int *base)
+{
+  const char *num_to_text;
 
-  if (base >= 0)
+  if (*base >= 0)
     {
       num_to_text = "0123456789abcdefghijklmnopqrstuvwxyz";
-      if (base <= 1)
-	base = 10;
-      else if (base > 36)
+      if (*base <= 1)
+	*base = 10;
+      else if (*base > 36)
 	{
 	  num_to_text = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
-	  if (base > 62)
-	    return 0;
+	  if (*base > 62)
+	    return NULL;
 	}
     }
   else
     {
-      base = -base;
-      if (base <= 1)
-	base = 10;
-      else if (base > 36)
-	return 0;
+      *base = -*base;
+      if (*base <= 1)
+	*base = 10;
+      else if (*base > 36)
+	return NULL;
       num_to_text = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
     }
 
+  return num_to_text;
+}
+
+static size_t
+out_str (FILE *stream, int fd, int base, mpz_srcptr x)
+{
+  mp_ptr xp;
+  mp_size_t x_size = SIZ (x);
+  size_t written;
+  out_str_t out;
+  TMP_DECL;
+
+  out.num_to_text = out_str_digits (&base);
+  if (out.num_to_text == NULL)
+    return 0;
+
+  out.stream = stream;
+  out.fd = fd;
+  out.failed = 0;
   written = 0;
 
   if (x_size < 0)
     {
-      fputc ('-', stream);
+      if (stream != NULL)
+	written = fputc ('-', stream) != EOF;
+      else
+	written = write (fd, "-", 1) == 1;
+      if (written == 0)
+	return 0;
       x_size = -x_size;
-      written = 1;
     }
 
   TMP_MARK;
 
-  DIGITS_IN_BASE_PER_LIMB (str_size, x_size, base);
-  str_size += 3;
-  str = (unsigned char *) TMP_ALLOC (str_size);
-
   xp = PTR (x);
   if (! POW2_P (base))
     {
@@ -94,19 +135,120 @@ mpz_out_str (FILE *stream, int base, mpz_srcptr x)
       MPN_COPY (xp, PTR (x), x_size);
     }
 
-  str_size = mpn_get_str (str, base, xp, x_size);
+  written += mpn_get_str_stream (base, xp, x_size, out_str_write, &out,
+					out.num_to_text);
 
-  /* Convert result to printable chars.  */
-  for (i = 0; i < str_size; i++)
-    str[i] = num_to_text[str[i]];
-  str[str_size] = 0;
+  TMP_FREE;
+  return out.failed ? 0 : written;
+}
 
-  {
-    size_t fwret;
-    fwret = fwrite ((char *) str, 1, str_size, stream);
-    written += fwret;
-  }
+size_t
+mpz_out_str (FILE *stream, int base, mpz_srcptr x)
+{
+  size_t written;
 
-  TMP_FREE;
+  if (stream == 0)
+    stream = stdout;
+
+  written = out_str (stream, -1, base, x);
   return ferror (stream) ? 0 : written;
 }
+
+/* Like mpz_out_str, but to the file descriptor fd.  */
+size_t
+mpz_out_fd (int fd, int base, mpz_srcptr x)
+{
+  return out_str (NULL, fd, base, x);
+}
+
+/* Digit checksums.  mpz_out_sum folds the digits into a sum and a CRC as
+   they come out of mpn_get_str_stream, instead of writing them, so that a
+   large number can be checked against an archived copy without storing its
+   string.  */
+typedef struct {
+  const char *num_to_text;
+  unsigned long crc_table[256];
+  unsigned long crc, sum, sum_mod, mod;
+} out_sum_t;
+
+static size_t
+out_sum_write (void *arg, unsigned char *str, size_t len)
+{
+  out_sum_t *out = (out_sum_t *) arg;
+  unsigned long crc = out->crc, sum = 0;
+  size_t i;
+
+  /* The digits come as values; the CRC is over their characters.  */
+  for (i = 0; i < len; i++)
+    {
+      sum += str[i];
+      crc = out->crc_table[(crc ^ out->num_to_text[str[i]]) & 0xff] ^ (crc >> 8);
+    }
+
+  out->crc = crc;
+  out->sum += sum;
+  out->sum_mod = (out->sum_mod + sum % out->mod) % out->mod;
+  return len;
+}
+
+/* Put in *sum the sum of the digit values of x in base, and in *crc the
+   CRC-32 of the characters mpz_out_str would write, as by zlib's crc32, and
+   return their number, without storing them.  As a check of the conversion,
+   the digit sum must equal |x| mod base-1; return 0 if it does not.  The
+   sum is kept in an unsigned long, which is 32 bits on LLP64 systems such as
+   64-bit Windows, so there it wraps modulo 2^32 above about 4e8 digits; the
+   check against |x| mod base-1 does not depend on it.  */
+size_t
+mpz_out_sum (int base, mpz_srcptr x, unsigned long *sum, unsigned long *crc)
+{
+  mp_ptr xp;
+  mp_size_t x_size = SIZ (x);
+  mp_limb_t x_mod;
+  size_t written;
+  unsigned long c;
+  out_sum_t out;
+  int i, j;
+  TMP_DECL;
+
+  out.num_to_text = out_str_digits (&base);
+  if (out.num_to_text == NULL)
+    return 0;
+
+  for (i = 0; i < 256; i++)
+    {
+      for (c = i, j = 0; j < 8; j++)
+	c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+      out.crc_table[i] = c;
+    }
+  out.crc = 0xffffffffUL;
+  out.sum = 0;
+  out.sum_mod = 0;
+  out.mod = base - 1;
+  written = 0;
+
+  if (x_size < 0)
+    {
+      out.crc = out.crc_table[(out.crc ^ '-') & 0xff] ^ (out.crc >> 8);
+      written = 1;
+      x_size = -x_size;
+    }
+
+  x_mod = x_size == 0 || out.mod == 1 ? 0 : mpn_mod_1 (PTR (x), x_size, out.mod);
+
+  TMP_MARK;
+
+  xp = PTR (x);
+  if (! POW2_P (base))
+    {
+      xp = TMP_ALLOC_LIMBS (x_size | 1);  /* |1 in case x_size==0 */
+      MPN_COPY (xp, PTR (x), x_size);
+    }
+
+  written += mpn_get_str_stream (base, xp, x_size, out_sum_write, &out, NULL);
+
+  TMP_FREE;
+
+  *sum = out.sum;
+  *crc = out.crc ^ 0xffffffffUL;
+  return out.sum_mod == x_mod ? written : 0;
+}
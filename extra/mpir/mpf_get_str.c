@@ -25,6 +25,7 @@ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
 MA 02110-1301, USA. */
 
 #include <stdlib.h>		/* for NULL */
+#include <string.h>		/* for strchr */
 #include "mpir.h"
 #include "gmp-impl.h"
 #include "longlong.h"		/* for count_leading_zeros */
@@ -118,7 +119,6 @@ mpf_get_str (char *dbuf, mp_exp_t *exp, int base, size_t n_digits, mpf_srcptr u)
   unsigned char *tstr;
   mp_exp_t exp_in_base;
   size_t n_digits_computed;
-  mp_size_t i;
   const char *num_to_text;
   size_t alloc_size = 0;
   char *dp;
@@ -208,7 +208,7 @@ mpf_get_str (char *dbuf, mp_exp_t *exp, int base, size_t n_digits, mpf_srcptr u)
 	  tn -= off;
 	  off = 0;
 	}
-      n_digits_computed = mpn_get_str (tstr, base, tp + off, tn - off);
+      n_digits_computed = mpn_get_str_text (tstr, base, tp + off, tn - off, num_to_text);
 
       exp_in_base = n_digits_computed - e;
     }
@@ -242,33 +242,35 @@ mpf_get_str (char *dbuf, mp_exp_t *exp, int base, size_t n_digits, mpf_srcptr u)
       mpn_tdiv_qr (tp, dummyp, (mp_size_t) 0, xp, xn, pp, pn);
       tn = xn - pn + 1;
       tn -= tp[tn - 1] == 0;
-      n_digits_computed = mpn_get_str (tstr, base, tp, tn);
+      n_digits_computed = mpn_get_str_text (tstr, base, tp, tn, num_to_text);
 
       exp_in_base = n_digits_computed + e;
     }
 
   /* We should normally have computed too many digits.  Round the result
-     at the point indicated by n_digits.  */
+     at the point indicated by n_digits.  The digits are already characters
+     of num_to_text, their values are looked up there.  */
   if (n_digits_computed > n_digits)
     {
       size_t i;
       /* Round the result.  */
-      if (tstr[n_digits] * 2 >= base)
+      if ((strchr (num_to_text, tstr[n_digits]) - num_to_text) * 2 >= base)
 	{
 	  n_digits_computed = n_digits;
 	  for (i = n_digits - 1;; i--)
 	    {
-	      unsigned int x;
-	      x = ++(tstr[i]);
-	      if (x != base)
-		break;
+	      if (tstr[i] != num_to_text[base - 1])
+		{
+		  tstr[i] = strchr (num_to_text, tstr[i])[1];
+		  break;
+		}
 	      n_digits_computed--;
 	      if (i == 0)
 		{
 		  /* We had something like `bbbbbbb...bd', where 2*d >= base
 		     and `b' denotes digit with significance base - 1.
 		     This rounds up to `1', increasing the exponent.  */
-		  tstr[0] = 1;
+		  tstr[0] = num_to_text[1];
 		  n_digits_computed = 1;
 		  exp_in_base++;
 		  break;
@@ -284,14 +286,13 @@ mpf_get_str (char *dbuf, mp_exp_t *exp, int base, size_t n_digits, mpf_srcptr u)
     n_digits = n_digits_computed;
 
   /* Remove trailing 0.  There can be many zeros.  */
-  while (n_digits != 0 && tstr[n_digits - 1] == 0)
+  while (n_digits != 0 && tstr[n_digits - 1] == num_to_text[0])
     n_digits--;
 
   dp = dbuf + (SIZ(u) < 0);
 
-  /* Translate to ASCII and copy to result string.  */
-  for (i = 0; i < n_digits; i++)
-    dp[i] = num_to_text[tstr[i]];
+  /* Copy to result string.  */
+  memcpy (dp, tstr, n_digits);
   dp[n_digits] = 0;
 
   *exp = exp_in_base;
@@ -10,10 +10,17 @@
  * gcc -DUSE_MPIR -O2 -pthread fac_test.c -o fac_test -lmpir -lm
  *
  * time ./fac_test 7200000 > out
+ *
+ * Or print the number of digits, their sum and the CRC-32 of the output,
+ * as from zlib's crc32, without storing the digits; the sum is checked
+ * against n! mod 9.
+ *
+ * time ./fac_test 7200000 sum
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <time.h>
 
@@ -67,7 +74,7 @@ double wall_clock ()
 #endif
 }
 
-void fact (int n)
+void fact (int n, int sum)
 {
   double wbegin, wend;
   mpz_t  p;
@@ -79,12 +86,32 @@ void fact (int n)
   fprintf(stderr, "mpz_fac_ui  : %9.3f secs.\n", wend - wbegin);
   fflush(stderr);
 
-  wbegin = wall_clock();
-  mpz_out_str(stdout, 10, p);
-  wend = wall_clock();
+  if (sum) {
+    unsigned long digit_sum, crc;
+    size_t digits;
 
-  fprintf(stderr, "mpz_out_str : %9.3f secs.\n", wend - wbegin);
-  fflush(stderr);
+    wbegin = wall_clock();
+    digits = mpz_out_sum(10, p, &digit_sum, &crc);
+    wend = wall_clock();
+
+    if (digits == 0) {
+      fprintf(stderr, "mpz_out_sum : digit sum check failed\n");
+      exit(1);
+    }
+    printf("digits %lu sum %lu crc32 %08lx\n",
+           (unsigned long) digits, digit_sum, crc);
+
+    fprintf(stderr, "mpz_out_sum : %9.3f secs.\n", wend - wbegin);
+    fflush(stderr);
+  }
+  else {
+    wbegin = wall_clock();
+    mpz_out_str(stdout, 10, p);
+    wend = wall_clock();
+
+    fprintf(stderr, "mpz_out_str : %9.3f secs.\n", wend - wbegin);
+    fflush(stderr);
+  }
 
   mpz_clear(p);
 }
@@ -94,12 +121,12 @@ int main (int argc, char *argv[])
   int n;
 
   if (argc <= 1) {
-    printf("Usage: %s <number>\n", argv[0]);
+    printf("Usage: %s <number> [sum]\n", argv[0]);
     return 1;
   }
   n = atoi(argv[1]);
   assert(n >= 0);
-  fact(n);
+  fact(n, argc > 2 && strcmp(argv[2], "sum") == 0);
 
   return 0;
 }
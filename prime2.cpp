@@ -4,7 +4,7 @@
     This is free and unencumbered public domain software; see http://unlicense.org/
     I believe this code to be correct, but I may be wrong; use at your own risk.
 
-    mul() and div() are modified versions of algorithms published in
+    mul_basecase() and div_schoolbook() are modified versions of algorithms published in
     Hacker's Delight: "You are free to use, copy, and distribute
     any of the code on this web site, whether modified by you or not."
     see http://hackersdelight.org/permissions.htm
@@ -12,6 +12,9 @@
     Compiled under OS X with g++ 4.2
         g++ -O3 prime2.cpp -o prime2
 
+        # using OpenMP to convert the parts of the number concurrently
+        g++ -O3 -fopenmp prime2.cpp -o prime2
+
     Compiled under Windows with VC++ 2010
         cl /nologo /EHs /O2 prime2.cpp /Feprime2.exe
 */
@@ -19,7 +22,9 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
+#include <climits>
 #include <stdint.h>
 
 
@@ -78,30 +83,682 @@ int num_bits(const num_vec_t & num)
 }
 
 
-// product <- a * b; a and b must be normalised
-void mul(num_vec_t & product, const num_vec_t & a, const num_vec_t & b)
+// return -1, 0 or 1 as 'a' is less than, equal to or greater than 'b';
+// a and b must be normalised
+int compare(const num_vec_t & a, const num_vec_t & b)
 {
-    // adapted from Hacker's Delight; originally from Knuth TAoCP V2 4.3.1
-    const unsigned a_len = a.size();
-    const unsigned b_len = b.size();
-    num_vec_t p(a_len + b_len, 0);
+    if (a.size() != b.size())
+        return a.size() < b.size() ? -1 : 1;
+    for (num_vec_t::size_type i = a.size(); i--; ) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
 
-    for (unsigned ai = 0; ai < a_len; ++ai) {
+
+// sum <- a + b; a and b must be normalised
+void add(num_vec_t & sum, const num_vec_t & a, const num_vec_t & b)
+{
+    const num_vec_t & x = a.size() >= b.size() ? a : b; // the longer one
+    const num_vec_t & y = a.size() >= b.size() ? b : a;
+    num_vec_t s(x.size() + 1);
+    uint64_t k = 0;
+    for (num_vec_t::size_type i = 0; i < x.size(); ++i) {
+        k += x[i];
+        if (i < y.size())
+            k += y[i];
+        s[i] = static_cast<num_frag_t>(k);
+        k >>= num_frag_t_size;
+    }
+    s[x.size()] = static_cast<num_frag_t>(k);
+
+    normalise(s);
+    sum.swap(s);
+}
+
+
+// difference <- a - b; a and b must be normalised and a >= b
+void sub(num_vec_t & difference, const num_vec_t & a, const num_vec_t & b)
+{
+    num_vec_t d(a.size());
+    int64_t k = 0; // 0, or -1 if we need to borrow
+    for (num_vec_t::size_type i = 0; i < a.size(); ++i) {
+        int64_t t = static_cast<int64_t>(a[i]) + k;
+        if (i < b.size())
+            t -= b[i];
+        d[i] = static_cast<num_frag_t>(t);
+        k = t >> num_frag_t_size;
+    }
+    if (k || a.size() < b.size())
+        throw std::runtime_error("sub() unsupported input");
+
+    normalise(d);
+    difference.swap(d);
+}
+
+
+// return 'num' * 2^bits; num must be normalised
+num_vec_t shift_left(const num_vec_t & num, int bits)
+{
+    const int frags = bits / num_frag_t_size;
+    bits %= num_frag_t_size;
+    num_vec_t r(frags + num.size() + 1, 0);
+    for (num_vec_t::size_type i = 0; i < num.size(); ++i) {
+        r[frags + i] |= num[i] << bits;
+        if (bits)
+            r[frags + i + 1] = num[i] >> (num_frag_t_size - bits);
+    }
+    normalise(r);
+    return r;
+}
+
+
+// return 'num' / 2^bits
+num_vec_t shift_right(const num_vec_t & num, int bits)
+{
+    const int frags = bits / num_frag_t_size;
+    bits %= num_frag_t_size;
+    num_vec_t r;
+    for (int i = frags; i < static_cast<int>(num.size()); ++i) {
+        num_frag_t x = num[i] >> bits;
+        if (bits && i + 1 < static_cast<int>(num.size()))
+            x |= num[i + 1] << (num_frag_t_size - bits);
+        r.push_back(x);
+    }
+    normalise(r);
+    return r;
+}
+
+
+// return 'len' fragments of 'num' starting from fragment 'pos', i.e.
+// (num / base^pos) % base^len, where base is 2^num_frag_t_size
+num_vec_t fragments(const num_vec_t & num, int pos, int len)
+{
+    num_vec_t r;
+    const int end = std::min(static_cast<int>(num.size()), pos + len);
+    if (pos < end)
+        r.assign(num.begin() + pos, num.begin() + end);
+    normalise(r);
+    return r;
+}
+
+
+// return 'num' * base^n, where base is 2^num_frag_t_size; num must be normalised
+num_vec_t shift_up(const num_vec_t & num, int n)
+{
+    if (num.size() == 1 && num[0] == 0)
+        return num;
+    num_vec_t r(n, 0);
+    r.insert(r.end(), num.begin(), num.end());
+    return r;
+}
+
+
+// below these many fragments mul() and sqr() use the O(n^2) loops (squaring
+// does half the work there, so it switches later), from toom3_threshold
+// fragments they split numbers in three rather than two, and from
+// ntt_threshold fragments they use number theoretic transforms
+const int karatsuba_threshold = 16;
+const int karatsuba_sqr_threshold = 24;
+const int toom3_threshold = 800;
+const int ntt_threshold = 4000;
+
+
+// p[0..an+bn) <- a[0..an) * b[0..bn)
+void mul_basecase(num_frag_t * p,
+    const num_frag_t * a, int an, const num_frag_t * b, int bn)
+{
+    // adapted from Hacker's Delight; originally from Knuth TAoCP V2 4.3.1
+    for (int i = 0; i < bn; ++i)
+        p[i] = 0;
+    for (int ai = 0; ai < an; ++ai) {
         uint64_t k = 0;
-        for (unsigned bi = 0; bi < b_len; ++bi) {
+        for (int bi = 0; bi < bn; ++bi) {
             const uint64_t t =
                 static_cast<uint64_t>(a[ai]) * static_cast<uint64_t>(b[bi])
                 + static_cast<uint64_t>(p[ai + bi]) + k;
             p[ai + bi] = static_cast<num_frag_t>(t);
             k = t >> num_frag_t_size;
         }
-        p[ai + b_len] = static_cast<num_frag_t>(k);
+        p[ai + bn] = static_cast<num_frag_t>(k);
+    }
+}
+
+
+// p[0..2n) <- a[0..n)^2
+void sqr_basecase(num_frag_t * p, const num_frag_t * a, int n)
+{
+    // each product a[i] * a[j] with i != j appears twice in the square, so
+    // sum those with i < j, double the sum and add the squares a[i] * a[i]
+    for (int i = 0; i < n; ++i)
+        p[i] = 0;
+    for (int i = 0; i < n; ++i) {
+        uint64_t k = 0;
+        for (int j = i + 1; j < n; ++j) {
+            const uint64_t t =
+                static_cast<uint64_t>(a[i]) * static_cast<uint64_t>(a[j])
+                + static_cast<uint64_t>(p[i + j]) + k;
+            p[i + j] = static_cast<num_frag_t>(t);
+            k = t >> num_frag_t_size;
+        }
+        p[i + n] = static_cast<num_frag_t>(k);
+    }
+
+    for (int i = 2 * n - 1; i > 0; --i)
+        p[i] = (p[i] << 1) | (p[i - 1] >> (num_frag_t_size - 1));
+    p[0] <<= 1;
+
+    uint64_t k = 0;
+    for (int i = 0; i < n; ++i) {
+        const uint64_t s = static_cast<uint64_t>(a[i]) * static_cast<uint64_t>(a[i]);
+        uint64_t t = static_cast<uint64_t>(p[2 * i]) + (s & 0xFFFFFFFF) + k;
+        p[2 * i] = static_cast<num_frag_t>(t);
+        t = static_cast<uint64_t>(p[2 * i + 1]) + (s >> num_frag_t_size) + (t >> num_frag_t_size);
+        p[2 * i + 1] = static_cast<num_frag_t>(t);
+        k = t >> num_frag_t_size;
+    }
+}
+
+
+// r[0..rn) <- r[0..rn) + a[0..an), an <= rn; return the carry out
+num_frag_t add_to(num_frag_t * r, int rn, const num_frag_t * a, int an)
+{
+    uint64_t k = 0;
+    int i = 0;
+    for (; i < an; ++i) {
+        k += static_cast<uint64_t>(r[i]) + a[i];
+        r[i] = static_cast<num_frag_t>(k);
+        k >>= num_frag_t_size;
+    }
+    for (; k && i < rn; ++i) {
+        k += r[i];
+        r[i] = static_cast<num_frag_t>(k);
+        k >>= num_frag_t_size;
     }
+    return static_cast<num_frag_t>(k);
+}
+
+
+// r[0..rn) <- r[0..rn) - a[0..an), an <= rn; return the borrow out
+num_frag_t sub_from(num_frag_t * r, int rn, const num_frag_t * a, int an)
+{
+    int64_t k = 0;
+    int i = 0;
+    for (; i < an; ++i) {
+        const int64_t t = static_cast<int64_t>(r[i]) - a[i] + k;
+        r[i] = static_cast<num_frag_t>(t);
+        k = t >> num_frag_t_size;
+    }
+    for (; k && i < rn; ++i) {
+        const int64_t t = static_cast<int64_t>(r[i]) + k;
+        r[i] = static_cast<num_frag_t>(t);
+        k = t >> num_frag_t_size;
+    }
+    return static_cast<num_frag_t>(-k);
+}
+
+
+// r[0..n) <- |a[0..n) - b[0..m)|, m <= n; return true if a < b
+bool abs_diff(num_frag_t * r, const num_frag_t * a, int n, const num_frag_t * b, int m)
+{
+    int i = n - 1;
+    while (i >= m && a[i] == 0)
+        --i;
+    if (i < m) {
+        while (i >= 0 && a[i] == b[i])
+            --i;
+    }
+    const bool less = i >= 0 && i < m && a[i] < b[i];
+
+    for (int j = 0; j < n; ++j)
+        r[j] = less ? (j < m ? b[j] : 0) : a[j];
+    if (less)
+        sub_from(r, n, a, n);
+    else
+        sub_from(r, n, b, m);
+    return less;
+}
+
+
+// the scratch mul_karatsuba() and sqr_karatsuba() need for n fragments
+int karatsuba_scratch(int n)
+{
+    return 6 * n + 8 * 32;
+}
+
 
+// p[0..2n) <- a[0..n) * b[0..n), using scratch t
+void mul_karatsuba(num_frag_t * p,
+    const num_frag_t * a, const num_frag_t * b, int n, num_frag_t * t)
+{
+    if (n < karatsuba_threshold) {
+        mul_basecase(p, a, n, b, n);
+        return;
+    }
+
+    // with a = a1 * base^h + a0 and b = b1 * base^h + b0, a * b is
+    //   z2 * base^2h + (z0 + z2 - (a0 - a1) * (b0 - b1)) * base^h + z0
+    // where z0 = a0 * b0 and z2 = a1 * b1; three multiplications, not four
+    const int h = (n + 1) / 2;
+    const int l = n - h;
+    num_frag_t * z = t + 2 * h;
+    num_frag_t * u = z + 2 * h;
+    const bool neg = abs_diff(t, a, h, a + h, l) != abs_diff(t + h, b, h, b + h, l);
+    mul_karatsuba(z, t, t + h, h, u + 2 * h + 1);
+    mul_karatsuba(p, a, b, h, u + 2 * h + 1);
+    mul_karatsuba(p + 2 * h, a + h, b + h, l, u + 2 * h + 1);
+
+    for (int i = 0; i < 2 * h; ++i)
+        u[i] = p[i];
+    u[2 * h] = 0;
+    add_to(u, 2 * h + 1, p + 2 * h, 2 * l);
+    if (neg)
+        add_to(u, 2 * h + 1, z, 2 * h);
+    else
+        sub_from(u, 2 * h + 1, z, 2 * h);
+    add_to(p + h, 2 * n - h, u, 2 * h + 1);
+}
+
+
+// p[0..2n) <- a[0..n)^2, using scratch t
+void sqr_karatsuba(num_frag_t * p, const num_frag_t * a, int n, num_frag_t * t)
+{
+    if (n < karatsuba_sqr_threshold) {
+        sqr_basecase(p, a, n);
+        return;
+    }
+
+    // as mul_karatsuba(), where (a0 - a1)^2 is never negative
+    const int h = (n + 1) / 2;
+    const int l = n - h;
+    num_frag_t * z = t + 2 * h;
+    num_frag_t * u = z + 2 * h;
+    abs_diff(t, a, h, a + h, l);
+    sqr_karatsuba(z, t, h, u + 2 * h + 1);
+    sqr_karatsuba(p, a, h, u + 2 * h + 1);
+    sqr_karatsuba(p + 2 * h, a + h, l, u + 2 * h + 1);
+
+    for (int i = 0; i < 2 * h; ++i)
+        u[i] = p[i];
+    u[2 * h] = 0;
+    add_to(u, 2 * h + 1, p + 2 * h, 2 * l);
+    sub_from(u, 2 * h + 1, z, 2 * h);
+    add_to(p + h, 2 * n - h, u, 2 * h + 1);
+}
+
+
+// r <- a + b, for a and b given as magnitudes and signs (true if negative)
+void add_signed(num_vec_t & r, bool & r_neg,
+    const num_vec_t & a, bool a_neg, const num_vec_t & b, bool b_neg)
+{
+    if (a_neg == b_neg) {
+        add(r, a, b);
+        r_neg = a_neg;
+    }
+    else if (compare(a, b) >= 0) {
+        sub(r, a, b);
+        r_neg = a_neg;
+    }
+    else {
+        sub(r, b, a);
+        r_neg = b_neg;
+    }
+    if (r.size() == 1 && r[0] == 0)
+        r_neg = false;
+}
+
+
+// num <- num / d, for a single fragment d
+void div_small(num_vec_t & num, num_frag_t d)
+{
+    uint64_t remainder = 0;
+    for (num_vec_t::size_type i = num.size(); i--; ) {
+        remainder = (remainder << num_frag_t_size) + num[i];
+        num[i] = static_cast<num_frag_t>(remainder / d);
+        remainder %= d;
+    }
+    normalise(num);
+}
+
+
+void mul(num_vec_t & product, const num_vec_t & a, const num_vec_t & b);
+void sqr(num_vec_t & square, const num_vec_t & a);
+
+
+// product <- a * b, or a^2 if 'square' (b is then not used); Toom-Cook 3-way
+// multiplication, five multiplications of a third of the size, not nine
+void mul_toom3(num_vec_t & product,
+    const num_vec_t & a, const num_vec_t & b, bool square)
+{
+    // a = a2 * x^2 + a1 * x + a0 where x = base^k, likewise b, and the
+    // product polynomial r(x) = a(x) * b(x) has five coefficients; find them
+    // from its values at 0, 1, -1, -2 and infinity (see Bodrato, Towards
+    // Optimal Toom-Cook Multiplication for Univariate and Multivariate
+    // Polynomials in Characteristic 2 and 0)
+    const int k = (static_cast<int>(std::max(a.size(), b.size())) + 2) / 3;
+    num_vec_t v[2][5]; // a and b at 0, 1, -1, -2 and infinity
+    bool neg[2][5] = { { false } };
+    for (int i = 0; i < (square ? 1 : 2); ++i) {
+        const num_vec_t & c = i ? b : a;
+        const num_vec_t c0(fragments(c, 0, k)), c1(fragments(c, k, k));
+        num_vec_t t;
+        v[i][0] = c0;
+        v[i][4] = fragments(c, 2 * k, k);
+        add(t, c0, v[i][4]);
+        add(v[i][1], t, c1);
+        add_signed(v[i][2], neg[i][2], t, false, c1, true);
+        add_signed(t, neg[i][3], v[i][2], neg[i][2], v[i][4], false);
+        add_signed(v[i][3], neg[i][3], shift_left(t, 1), neg[i][3], c0, true);
+    }
+
+    num_vec_t r[5];
+    bool r_neg[5];
+    for (int j = 0; j < 5; ++j) {
+        if (square) {
+            sqr(r[j], v[0][j]);
+            r_neg[j] = false;
+        }
+        else {
+            mul(r[j], v[0][j], v[1][j]);
+            r_neg[j] = (neg[0][j] != neg[1][j]) && !(r[j].size() == 1 && r[j][0] == 0);
+        }
+    }
+
+    // interpolate; each division is exact
+    num_vec_t r1, r2, r3;
+    bool r1_neg, r2_neg, r3_neg;
+    add_signed(r3, r3_neg, r[3], r_neg[3], r[1], !r_neg[1]);
+    div_small(r3, 3);                                           // (r(-2) - r(1)) / 3
+    add_signed(r1, r1_neg, r[1], r_neg[1], r[2], !r_neg[2]);
+    r1 = shift_right(r1, 1);                                    // (r(1) - r(-1)) / 2
+    add_signed(r2, r2_neg, r[2], r_neg[2], r[0], true);         // r(-1) - r(0)
+    add_signed(r3, r3_neg, r2, r2_neg, r3, !r3_neg);
+    r3 = shift_right(r3, 1);
+    add_signed(r3, r3_neg, r3, r3_neg, shift_left(r[4], 1), false); // (r2 - r3) / 2 + 2 r(inf)
+    add_signed(r2, r2_neg, r2, r2_neg, r1, r1_neg);
+    add_signed(r2, r2_neg, r2, r2_neg, r[4], true);             // r2 + r1 - r(inf)
+    add_signed(r1, r1_neg, r1, r1_neg, r3, !r3_neg);            // r1 - r3
+
+    // the coefficients are the products' and not negative; add them up
+    num_vec_t p(a.size() + (square ? a.size() : b.size()) + 1, 0);
+    const num_vec_t * c[5] = { &r[0], &r1, &r2, &r3, &r[4] };
+    for (int j = 0; j < 5; ++j) {
+        const int n = static_cast<int>(c[j]->size());
+        if (j * k < static_cast<int>(p.size()))
+            add_to(&p[j * k], static_cast<int>(p.size()) - j * k,
+                &(*c[j])[0], std::min(n, static_cast<int>(p.size()) - j * k));
+    }
     normalise(p);
     product.swap(p);
 }
 
+
+// number theoretic transform (NTT) multiplication: the product's fragments
+// are the coefficients of the product of two polynomials, found by
+// convolution modulo three primes p = c * 2^k + 1 below 2^31 and put
+// together by the Chinese remainder theorem; each coefficient is less than
+// n * 2^64 for n fragments, which fits in the primes' product of about 2^90
+const uint32_t ntt_p1 = 2013265921; // 15 * 2^27 + 1, primitive root 31
+const uint32_t ntt_p2 = 1811939329; // 27 * 2^26 + 1, primitive root 13
+const uint32_t ntt_p3 = 469762049;  //  7 * 2^26 + 1, primitive root 3
+const int ntt_max_size = 1 << 26;   // the longest transform all three allow
+
+
+// return x^e mod p
+uint32_t pow_mod(uint32_t x, uint64_t e, uint32_t p)
+{
+    uint64_t r = 1, y = x % p;
+    for (; e; e >>= 1) {
+        if (e & 1)
+            r = r * y % p;
+        y = y * y % p;
+    }
+    return static_cast<uint32_t>(r);
+}
+
+
+// return x * w mod p for x < 2^32, where w_shoup = floor(w * 2^32 / p);
+// Shoup's method needs no division, only 32-bit products, so the compiler
+// can vectorise the butterflies that use it
+inline uint32_t mul_mod_shoup(uint32_t x, uint32_t w, uint32_t w_shoup, uint32_t p)
+{
+    const uint32_t q = static_cast<uint32_t>((static_cast<uint64_t>(x) * w_shoup) >> 32);
+    const uint32_t r = x * w - q * p; // 0 <= r < 2p
+    return r >= p ? r - p : r;
+}
+
+
+// w[m + j] <- root^(j * n / 2m) mod P, for m = 1, 2, 4 .. n/2 and j < m, and
+// ws[] the matching Shoup constants; root must be a primitive nth root of 1
+template <uint32_t P>
+void ntt_roots(std::vector<uint32_t> & w, std::vector<uint32_t> & ws, int n, uint32_t root)
+{
+    w.resize(n);
+    ws.resize(n);
+    for (int m = 1; m < n; m *= 2) {
+        const uint64_t r = pow_mod(root, n / (2 * m), P);
+        uint64_t x = 1;
+        for (int j = 0; j < m; ++j) {
+            w[m + j] = static_cast<uint32_t>(x);
+            ws[m + j] = static_cast<uint32_t>((x << 32) / P);
+            x = x * r % P;
+        }
+    }
+}
+
+
+// a[0..n) <- its transform modulo P, in bit-reversed order (decimation in
+// frequency); n must be a power of 2
+template <uint32_t P>
+void ntt_forward(uint32_t * a, int n, const uint32_t * w, const uint32_t * ws)
+{
+    for (int m = n / 2; m >= 1; m /= 2) {
+        for (int i = 0; i < n; i += 2 * m) {
+            uint32_t * x = a + i;
+            uint32_t * y = a + i + m;
+            for (int j = 0; j < m; ++j) {
+                const uint32_t u = x[j], v = y[j];
+                const uint32_t s = u + v;
+                x[j] = s >= P ? s - P : s;
+                y[j] = mul_mod_shoup(u - v + P, w[m + j], ws[m + j], P);
+            }
+        }
+    }
+}
+
+
+// a[0..n) <- n times its inverse transform modulo P, taking the bit-reversed
+// order ntt_forward() gives (decimation in time); w[] must hold the inverse
+// roots
+template <uint32_t P>
+void ntt_inverse(uint32_t * a, int n, const uint32_t * w, const uint32_t * ws)
+{
+    for (int m = 1; m < n; m *= 2) {
+        for (int i = 0; i < n; i += 2 * m) {
+            uint32_t * x = a + i;
+            uint32_t * y = a + i + m;
+            for (int j = 0; j < m; ++j) {
+                const uint32_t u = x[j];
+                const uint32_t v = mul_mod_shoup(y[j], w[m + j], ws[m + j], P);
+                const uint32_t s = u + v, d = u - v + P;
+                x[j] = s >= P ? s - P : s;
+                y[j] = d >= P ? d - P : d;
+            }
+        }
+    }
+}
+
+
+// c[0..n) <- the cyclic convolution of a and b modulo P, or of a with itself
+// if 'square'; n must be a power of 2 and at least a.size() + b.size() - 1
+template <uint32_t P, uint32_t G>
+void ntt_convolve(std::vector<uint32_t> & c,
+    const num_vec_t & a, const num_vec_t & b, bool square, int n)
+{
+    const uint32_t root = pow_mod(G, (P - 1) / n, P);
+    std::vector<uint32_t> w, ws;
+    std::vector<uint32_t> fa(n, 0), fb;
+
+    ntt_roots<P>(w, ws, n, root);
+    for (num_vec_t::size_type i = 0; i < a.size(); ++i)
+        fa[i] = a[i] % P;
+    ntt_forward<P>(&fa[0], n, &w[0], &ws[0]);
+    if (!square) {
+        fb.resize(n, 0);
+        for (num_vec_t::size_type i = 0; i < b.size(); ++i)
+            fb[i] = b[i] % P;
+        ntt_forward<P>(&fb[0], n, &w[0], &ws[0]);
+    }
+
+    // multiply pointwise, dividing by n for the inverse transform
+    const uint64_t n_inv = pow_mod(n, P - 2, P);
+    const std::vector<uint32_t> & g = square ? fa : fb;
+    for (int i = 0; i < n; ++i)
+        fa[i] = static_cast<uint32_t>(static_cast<uint64_t>(fa[i]) * g[i] % P * n_inv % P);
+
+    ntt_roots<P>(w, ws, n, pow_mod(root, P - 2, P));
+    ntt_inverse<P>(&fa[0], n, &w[0], &ws[0]);
+    c.swap(fa);
+}
+
+
+// c1[i] + c2[i] * base + c3[i] * base^2 <- the ith coefficient of the
+// polynomial product of a and b, or of a with itself if 'square' (b is then
+// not used), for i < a.size() + b.size() - 1; base is 2^32, whatever base
+// the fragments of a and b are in, as long as their products add up to
+// less than ntt_p1 * ntt_p2 * ntt_p3
+void ntt_coefficients(std::vector<uint32_t> & c1, std::vector<uint32_t> & c2,
+    std::vector<uint32_t> & c3, const num_vec_t & a, const num_vec_t & b, bool square)
+{
+    const int len = static_cast<int>(a.size() + (square ? a.size() : b.size())) - 1;
+    int n = 1;
+    while (n < len)
+        n *= 2;
+
+    ntt_convolve<ntt_p1, 31>(c1, a, b, square, n);
+    ntt_convolve<ntt_p2, 13>(c2, a, b, square, n);
+    ntt_convolve<ntt_p3, 3>(c3, a, b, square, n);
+
+    // each coefficient is x = r1 + p1 * (s + p2 * t) for its residues r1, r2
+    // and r3, where s < p2 and t < p3 are found from r2 and r3 (Garner's
+    // method)
+    const uint64_t p1_inv_p2 = pow_mod(ntt_p1, ntt_p2 - 2, ntt_p2);
+    const uint64_t p1p2 = static_cast<uint64_t>(ntt_p1) * ntt_p2;
+    const uint64_t p1p2_inv_p3 = pow_mod(static_cast<uint32_t>(p1p2 % ntt_p3), ntt_p3 - 2, ntt_p3);
+    const uint64_t p1_p3 = ntt_p1 % ntt_p3;
+    const uint64_t lo = 0xFFFFFFFF;
+    for (int i = 0; i < len; ++i) {
+        const uint64_t r1 = c1[i];
+        const uint64_t s = (c2[i] + ntt_p2 - r1 % ntt_p2) * p1_inv_p2 % ntt_p2;
+        const uint64_t t = (c3[i] + 2 * ntt_p3 - r1 % ntt_p3 - p1_p3 * s % ntt_p3)
+            * p1p2_inv_p3 % ntt_p3;
+        const uint64_t x = r1 + ntt_p1 * s;          // < 2^63
+        const uint64_t y0 = (p1p2 & lo) * t;         // p1 * p2 * t, in two parts
+        const uint64_t y1 = (p1p2 >> 32) * t;
+        const uint64_t w0 = (x & lo) + (y0 & lo);
+        const uint64_t w1 = (x >> 32) + (y0 >> 32) + (y1 & lo) + (w0 >> 32);
+        const uint64_t w2 = (y1 >> 32) + (w1 >> 32);
+        c1[i] = static_cast<uint32_t>(w0);
+        c2[i] = static_cast<uint32_t>(w1);
+        c3[i] = static_cast<uint32_t>(w2);
+    }
+}
+
+
+// product <- a * b, or a^2 if 'square' (b is then not used); the product may
+// have at most ntt_max_size + 1 fragments
+void mul_ntt(num_vec_t & product,
+    const num_vec_t & a, const num_vec_t & b, bool square)
+{
+    const int an = static_cast<int>(a.size());
+    const int bn = square ? an : static_cast<int>(b.size());
+    const int len = an + bn - 1; // number of coefficients
+    std::vector<uint32_t> c1, c2, c3;
+    ntt_coefficients(c1, c2, c3, a, b, square);
+
+    // add each coefficient times base^i into the product, carrying the
+    // excess in k0 + k1 * base + k2 * base^2, each part less than base
+    const uint64_t lo = 0xFFFFFFFF;
+    num_vec_t p(an + bn, 0);
+    uint64_t k0 = 0, k1 = 0, k2 = 0;
+    for (int i = 0; i < len; ++i) {
+        const uint64_t w0 = k0 + c1[i];
+        const uint64_t w1 = k1 + c2[i] + (w0 >> num_frag_t_size);
+        const uint64_t w2 = k2 + c3[i] + (w1 >> num_frag_t_size);
+        p[i] = static_cast<num_frag_t>(w0);
+        k0 = w1 & lo;
+        k1 = w2 & lo;
+        k2 = w2 >> num_frag_t_size;
+    }
+    p[len] = static_cast<num_frag_t>(k0);
+    normalise(p);
+    product.swap(p);
+}
+
+
+// product <- a * b; a and b must be normalised
+void mul(num_vec_t & product, const num_vec_t & a, const num_vec_t & b)
+{
+    if (&a == &b) {
+        sqr(product, a);
+        return;
+    }
+    const num_vec_t & x = a.size() >= b.size() ? a : b; // the longer one
+    const num_vec_t & y = a.size() >= b.size() ? b : a;
+    const int xn = static_cast<int>(x.size());
+    const int yn = static_cast<int>(y.size());
+    num_vec_t p(xn + yn, 0);
+
+    if (yn < karatsuba_threshold)
+        mul_basecase(&p[0], &x[0], xn, &y[0], yn);
+    else if (yn >= ntt_threshold && xn + yn - 1 <= ntt_max_size)
+        mul_ntt(p, x, y, false);
+    else if (xn >= 2 * yn) {
+        // multiply y by x in pieces of y's size and add up the products
+        num_vec_t t;
+        for (int i = 0; i < xn; i += yn) {
+            mul(t, fragments(x, i, yn), y);
+            add_to(&p[i], xn + yn - i, &t[0], std::min(static_cast<int>(t.size()), xn + yn - i));
+        }
+    }
+    else if (yn >= toom3_threshold) {
+        mul_toom3(p, x, y, false);
+    }
+    else {
+        // pad y to x's size
+        num_vec_t y2(y), t(karatsuba_scratch(xn));
+        y2.resize(xn, 0);
+        p.resize(2 * xn);
+        mul_karatsuba(&p[0], &x[0], &y2[0], xn, &t[0]);
+    }
+
+    normalise(p);
+    product.swap(p);
+}
+
+
+// square <- a^2; a must be normalised
+void sqr(num_vec_t & square, const num_vec_t & a)
+{
+    const int n = static_cast<int>(a.size());
+    num_vec_t p(2 * n, 0);
+
+    if (n < karatsuba_sqr_threshold)
+        sqr_basecase(&p[0], &a[0], n);
+    else if (n >= ntt_threshold && 2 * n - 1 <= ntt_max_size)
+        mul_ntt(p, a, a, true);
+    else if (n >= toom3_threshold)
+        mul_toom3(p, a, a, true);
+    else {
+        num_vec_t t(karatsuba_scratch(n));
+        sqr_karatsuba(&p[0], &a[0], n, &t[0]);
+    }
+
+    normalise(p);
+    square.swap(p);
+}
+
 inline num_vec_t & operator*=(num_vec_t & lhs, const num_vec_t & rhs)
 {
     mul(lhs, rhs, lhs);
@@ -109,8 +766,8 @@ inline num_vec_t & operator*=(num_vec_t & lhs, const num_vec_t & rhs)
 }
 
 
-// quotient <- u / v; remainder <- u % v
-void div(num_vec_t & quotient, num_vec_t & remainder,
+// quotient <- u / v; remainder <- u % v; O(m*n) for m and n fragments
+void div_schoolbook(num_vec_t & quotient, num_vec_t & remainder,
     const num_vec_t & u, const num_vec_t & v)
 {
     // adapted from Hacker's Delight; originally from Knuth TAoCP V2 4.3.1
@@ -136,17 +793,19 @@ void div(num_vec_t & quotient, num_vec_t & remainder,
     }
 
     // copy v to vn shifting it to the left so the most significant bit is 1
+    // (the 64-bit shifts give 0 when s is 0, where a 32-bit shift by 32
+    // would be undefined)
     const int s = count_leading_zeros(v[n-1]); // 0 <= s <= 31.
     num_vec_t vn(n); // (Hacker's Delight allocates 2n)
     for (int i = n - 1; i > 0; --i)
-        vn[i] = (v[i] << s) | (v[i-1] >> (num_frag_t_size - s));
+        vn[i] = (v[i] << s) | static_cast<num_frag_t>(static_cast<uint64_t>(v[i-1]) >> (num_frag_t_size - s));
     vn[0] = v[0] << s;
 
     // copy u to un shifting it to the left by same amount as we did v above
     num_vec_t un(m + 1); // (Hacker's Delight allocates 2(m + 1))
-    un[m] = u[m-1] >> (num_frag_t_size - s);
+    un[m] = static_cast<num_frag_t>(static_cast<uint64_t>(u[m-1]) >> (num_frag_t_size - s));
     for (int i = m - 1; i > 0; i--)
-        un[i] = (u[i] << s) | (u[i-1] >> (num_frag_t_size - s));
+        un[i] = (u[i] << s) | static_cast<num_frag_t>(static_cast<uint64_t>(u[i-1]) >> (num_frag_t_size - s));
     un[0] = u[0] << s;
 
     for (int j = m - n; j >= 0; --j) {
@@ -188,19 +847,221 @@ void div(num_vec_t & quotient, num_vec_t & remainder,
     }
 
     for (int i = 0; i < n; ++i)
-        r[i] = (un[i] >> s) | (un[i+1] << (num_frag_t_size - s));
+        r[i] = (un[i] >> s) | static_cast<num_frag_t>(static_cast<uint64_t>(un[i+1]) << (num_frag_t_size - s));
 
     normalise(q); quotient.swap(q);
     normalise(r); remainder.swap(r); 
 }
 
 
-// return decimal representation of given 'num' zero padded to 'width'
-std::string to_string_fixed_width(
+// the divisor size, in fragments, from which div() uses div_recursive()
+// rather than div_schoolbook(), and div_newton() rather than div_recursive();
+// div_recursive() is faster from about 250 fragments, and div_newton(),
+// which is only as fast as mul(), from about 150,000 fragments with the NTT
+// mul(), where it is a third faster by 500,000 fragments
+const int bz_threshold = 60;
+const int newton_threshold = 150000;
+
+void div(num_vec_t & quotient, num_vec_t & remainder,
+    const num_vec_t & u, const num_vec_t & v);
+
+void div_2n_by_1n(num_vec_t & quotient, num_vec_t & remainder,
+    const num_vec_t & a, const num_vec_t & b, int n);
+
+
+// quotient <- a / b; remainder <- a % b; where a = [a1 a2 a3] and b = [b1 b2]
+// in parts of h fragments, the most significant bit of b is set and
+// a < b * base^h (so the quotient fits in h fragments)
+void div_3n_by_2n(num_vec_t & quotient, num_vec_t & remainder,
+    const num_vec_t & a, const num_vec_t & b, int h)
+{
+    const num_vec_t b1(fragments(b, h, h));
+    num_vec_t q, r, d;
+
+    // estimate the quotient as [a1 a2] / b1; it is at most 2 too big
+    if (compare(fragments(a, 2 * h, h), b1) < 0)
+        div_2n_by_1n(q, r, fragments(a, h, 2 * h), b1, h);
+    else {
+        // a1 == b1 (it can't be bigger), so the estimate is base^h - 1 and
+        // [a1 a2] - (base^h - 1) * b1 = a2 + b1
+        q.assign(h, ~static_cast<num_frag_t>(0));
+        add(r, fragments(a, h, h), b1);
+    }
+
+    // the remainder is [r a3] - q * b2; while that is negative q is too big
+    mul(d, q, fragments(b, 0, h));
+    add(r, shift_up(r, h), fragments(a, 0, h));
+    const num_vec_t one(1, 1);
+    while (compare(r, d) < 0) {
+        add(r, r, b);
+        sub(q, q, one);
+    }
+    sub(remainder, r, d);
+    quotient.swap(q);
+}
+
+
+// quotient <- a / b; remainder <- a % b; where b has n fragments, its most
+// significant bit is set and a < b * base^n (so the quotient fits in n
+// fragments); n is a multiple of a power of 2 so that it halves evenly
+void div_2n_by_1n(num_vec_t & quotient, num_vec_t & remainder,
+    const num_vec_t & a, const num_vec_t & b, int n)
+{
+    if (n % 2 || n < bz_threshold) {
+        if (compare(a, b) < 0) {
+            num_vec_t r(a);
+            quotient.assign(1, 0);
+            remainder.swap(r);
+        }
+        else
+            div_schoolbook(quotient, remainder, a, b);
+        return;
+    }
+
+    // divide [a1 a2 a3 a4], in parts of h fragments, in two steps, each
+    // giving h fragments of the quotient: [a1 a2 a3] by b, then [r a4] by b
+    const int h = n / 2;
+    num_vec_t q1, q2, r;
+    div_3n_by_2n(q1, r, fragments(a, h, 3 * h), b, h);
+    add(r, shift_up(r, h), fragments(a, 0, h));
+    div_3n_by_2n(q2, remainder, r, b, h);
+    add(quotient, shift_up(q1, h), q2);
+}
+
+
+// quotient <- u / v; remainder <- u % v; recursive division as described by
+// Burnikel and Ziegler, which is as fast as the multiplication it relies on
+void div_recursive(num_vec_t & quotient, num_vec_t & remainder,
+    const num_vec_t & u, const num_vec_t & v)
+{
+    // make the divisor n = j * 2^k fragments long, j < bz_threshold, with its
+    // most significant bit set, by shifting both u and v left
+    int m = 1;
+    while (m * bz_threshold <= static_cast<int>(v.size()))
+        m *= 2;
+    const int n = (static_cast<int>(v.size()) + m - 1) / m * m;
+    const int shift = n * num_frag_t_size - num_bits(v);
+    const num_vec_t b(shift_left(v, shift));
+    const num_vec_t a(shift_left(u, shift));
+
+    // split a in t parts of n fragments, the most significant part being
+    // less than b / 2, and divide by b from the left two parts at a time
+    const int t = std::max(2, (num_bits(a) + n * num_frag_t_size) / (n * num_frag_t_size));
+    num_vec_t q(1, 0), qi, r, z(fragments(a, (t - 2) * n, 2 * n));
+    for (int i = t - 2; ; --i) {
+        div_2n_by_1n(qi, r, z, b, n);
+        add(q, shift_up(q, n), qi);
+        if (i == 0)
+            break;
+        add(z, shift_up(r, n), fragments(a, (i - 1) * n, n));
+    }
+
+    remainder = shift_right(r, shift);
+    quotient.swap(q);
+}
+
+
+// return base^(2n) / v, give or take a few, where v has n fragments and its
+// most significant bit is set
+num_vec_t reciprocal(const num_vec_t & v)
+{
+    const int n = static_cast<int>(v.size());
+    const num_vec_t one(1, 1);
+    num_vec_t x, e;
+
+    if (n < bz_threshold) {
+        div(x, e, shift_up(one, 2 * n), v);
+        return x;
+    }
+
+    // start from x0 = xh * base^(n-h), where xh is the reciprocal of the top
+    // h fragments of v, and take one step of Newton's iteration
+    //   x = x0 + x0 * (base^2n - v * x0) / base^2n
+    // which doubles the number of correct fragments
+    const int h = n / 2 + 1;
+    const num_vec_t xh(reciprocal(fragments(v, n - h, h)));
+    const num_vec_t bnh(shift_up(one, n + h));
+    mul(e, v, xh);
+    x = shift_up(xh, n - h);
+    if (compare(e, bnh) <= 0) {
+        sub(e, bnh, e); // (base^2n - v * x0) / base^(n-h)
+        mul(e, e, xh);
+        add(x, x, fragments(e, 2 * h, e.size()));
+    }
+    else {
+        sub(e, e, bnh);
+        mul(e, e, xh);
+        sub(x, x, fragments(e, 2 * h, e.size()));
+    }
+    return x;
+}
+
+
+// quotient <- u / v; remainder <- u % v; by multiplying u by the reciprocal
+// of v, which is faster than div_recursive() for large enough numbers given
+// a fast mul(); the quotient must be shorter than v
+void div_newton(num_vec_t & quotient, num_vec_t & remainder,
+    const num_vec_t & u, const num_vec_t & v)
+{
+    const int s = count_leading_zeros(v.back());
+    const num_vec_t b(shift_left(v, s));
+    const num_vec_t a(shift_left(u, s));
+    const int n = static_cast<int>(b.size());
+    const int m = static_cast<int>(a.size());
+
+    // the reciprocal of the top k fragments of b gives a quotient of up to
+    // k - 1 fragments to within a few units
+    const int k = std::min(n, m - n + 2);
+    const num_vec_t x(reciprocal(fragments(b, n - k, k)));
+    num_vec_t q, p, r;
+    mul(q, fragments(a, n - k, m), x);
+    q = fragments(q, 2 * k, q.size());
+
+    // correct the quotient so that 0 <= a - q * b < b
+    const num_vec_t one(1, 1);
+    mul(p, q, b);
+    while (compare(p, a) > 0) {
+        sub(p, p, b);
+        sub(q, q, one);
+    }
+    sub(r, a, p);
+    while (compare(r, b) >= 0) {
+        sub(r, r, b);
+        add(q, q, one);
+    }
+
+    remainder = shift_right(r, s);
+    quotient.swap(q);
+}
+
+
+// quotient <- u / v; remainder <- u % v
+void div(num_vec_t & quotient, num_vec_t & remainder,
+    const num_vec_t & u, const num_vec_t & v)
+{
+    const int m = static_cast<int>(u.size());
+    const int n = static_cast<int>(v.size());
+    if (m < n || n <= 0 || v[n-1] == 0)
+        throw std::runtime_error("div() unsupported input");
+
+    if (n < bz_threshold || m - n < bz_threshold)
+        div_schoolbook(quotient, remainder, u, v);
+    else if (n < newton_threshold || m - n >= n)
+        div_recursive(quotient, remainder, u, v);
+    else
+        div_newton(quotient, remainder, u, v);
+}
+
+
+// write decimal representation of given 'num' zero padded to 'width' to
+// first[0..width); num must have no more than width digits
+void to_string_fixed_width(
     num_vec_t num, // pass-by-value because algorithm is destructive
-    int width) // result will be at least this wide, zero filled if necessary
+    char * first,
+    int width)
 {
-    std::vector<char> result;
+    // the digits are found least significant first, so fill in from the right
+    char * last = first + width;
     // keep dividing num by 1,000,000,000 until it is 0; the remainder of each
     // division is the next least significant 9 decimal digits in the result
     while (!num.empty()) {
@@ -219,20 +1080,16 @@ std::string to_string_fixed_width(
 
         // extract the next 9 digits from the remainder
         for (int j = 0; j < 9; ++j) {
-            result.push_back(static_cast<char>(remainder % 10) + '0');
+            *--last = static_cast<char>(remainder % 10) + '0';
             remainder /= 10;
             if (remainder == 0 && num.empty())
-                break; // don't append superfluous zeros; e.g. 000000012 => 12
+                break; // don't write superfluous zeros; e.g. 000000012 => 12
         }
     }
 
     // add any necessary leading zeros to make the result the required width
-    width -= static_cast<int>(result.size());
-    while (width-- > 0)
-        result.push_back('0');
-
-    // the least-significant decimal digit is first so return result reversed
-    return std::string(result.rbegin(), result.rend());
+    while (last != first)
+        *--last = '0';
 }
 
 
@@ -261,7 +1118,7 @@ pot_vec_t powers_of_ten(int s)
     p.push_back(10);
     int power(1); // p = 10^power
     while (num_bits(p) < s) {
-        p *= p;     // the next value is the previous value squared,
+        sqr(p, p);  // the next value is the previous value squared,
         power *= 2; // which means the power has doubled
         if (power > 1000)
             result.push_back(power_of_ten(p, power));
@@ -270,17 +1127,24 @@ pot_vec_t powers_of_ten(int s)
 }
 
 
-// return given 'num' as a decimal string
-std::string to_string_helper(
+// parts of numbers with at least this many bits are converted as OpenMP tasks
+// by to_string_helper(); smaller ones are not worth a task
+const int task_threshold = 1 << 16;
+
+
+// write given 'num' in decimal to first[0..width), zero filled on the left;
+// num must have no more than width digits
+void to_string_helper(
     const num_vec_t & num,
     pot_vec_t::const_reverse_iterator p,
     const pot_vec_t::const_reverse_iterator p_end,
+    char * first,
     int width)
 {
     if (p == p_end || num_bits(num) <= p->bit_count) {
         // don't need to break number into smaller pieces; it's small
         // enough to use our O(n^2) algorithm directly
-        return to_string_fixed_width(num, width);
+        to_string_fixed_width(num, first, width);
     }
     else {
         // num is too big to convert directly; break it up first
@@ -293,28 +1157,66 @@ std::string to_string_helper(
         while (num_bits(quotient) > p->bit_count)
             div(quotient, parts[count++], quotient, p->n);
 
-        // then do same again for each part, collecting results into one string
-        std::string result(to_string_helper(quotient, p + 1, p_end, p->power));
-        while (count)
-            result += to_string_helper(parts[--count], p + 1, p_end, p->power);
-
-        return result;
+        // then do same again for each part, straight into its place: parts[i]
+        // is digits i * p->power to (i + 1) * p->power counting from the right
+        // and the quotient is the rest; the parts are independent so when
+        // compiled with OpenMP the big ones are converted concurrently
+        const int power = p->power;
+        for (int i = 0; i <= count; ++i) {
+#if defined(_OPENMP)
+#pragma omp task shared(parts, quotient) if (p->bit_count >= task_threshold)
+#endif
+            if (i < count)
+                to_string_helper(parts[i], p + 1, p_end, first + width - (i + 1) * power, power);
+            else
+                to_string_helper(quotient, p + 1, p_end, first, width - count * power);
+        }
+#if defined(_OPENMP)
+#pragma omp taskwait
+#endif
     }
 }
 
 
-// return given 'num' as a decimal string
-std::string to_string(const num_vec_t & num)
+// return the most decimal digits 'num' can have, from its number of bits
+// times log10(2); this is exact for (2^n)-1, as 2^n is not a power of ten
+int max_decimal_digits(const num_vec_t & num)
+{
+    return static_cast<int>(num_bits(num) * 0.30102999566398120) + 1;
+}
+
+
+// write given 'num' in decimal to first[0..width), zero filled on the left;
+// num must have no more than width digits, see max_decimal_digits()
+void to_decimal(const num_vec_t & num, char * first, int width)
 {
     // construct a table of powers of 10 appropriate to the size of the given
     // number and use it convert the number to decimal
     const pot_vec_t powers(powers_of_ten(num_bits(num) / 2));
-    std::string result(to_string_helper(num, powers.rbegin(), powers.rend(), 0));
+#if defined(_OPENMP)
+#pragma omp parallel
+#pragma omp single
+#endif
+    to_string_helper(num, powers.rbegin(), powers.rend(), first, width);
+}
+
+
+// return given 'num' as a decimal string
+std::string to_string(const num_vec_t & num)
+{
+    // each digit is written once, in place; only if max_decimal_digits() is
+    // one too many is the result moved to remove the leading zero
+    std::string result(max_decimal_digits(num), '0');
+    to_decimal(num, &result[0], static_cast<int>(result.size()));
 
     // remove all leading zeros from the result and return it,
     // or return "0" if the result was nothing but zeros
-    result.erase(0, result.find_first_not_of('0'));
-    return result.empty() ? std::string("0") : result;
+    const std::string::size_type i = result.find_first_not_of('0');
+    if (i == std::string::npos)
+        return std::string("0");
+    if (i)
+        result.erase(0, i);
+    return result;
 }
 
 
@@ -344,6 +1246,110 @@ std::string prime_str(int n)
 
 
 
+// prime_str_direct() finds (2^n)-1 in decimal with no conversion from
+// binary; the decimal numbers it works on are held in num_vec_t too, in
+// base 10^9, so each fragment is 9 decimal digits, least significant first
+const num_frag_t dec_base = 1000000000;
+
+// from this many fragments dec_sqr() uses number theoretic transforms
+const int dec_ntt_threshold = 128;
+
+
+// square <- a^2; a and square are in base 10^9 and normalised
+void dec_sqr(num_vec_t & square, const num_vec_t & a)
+{
+    const int n = static_cast<int>(a.size());
+    num_vec_t p(2 * n, 0);
+
+    if (n < dec_ntt_threshold) {
+        for (int i = 0; i < n; ++i) {
+            uint64_t k = 0;
+            for (int j = 0; j < n; ++j) {
+                const uint64_t t = static_cast<uint64_t>(a[i]) * a[j] + p[i + j] + k;
+                p[i + j] = static_cast<num_frag_t>(t % dec_base);
+                k = t / dec_base;
+            }
+            p[i + n] = static_cast<num_frag_t>(k);
+        }
+    }
+    else if (2 * n - 1 <= ntt_max_size) {
+        // the coefficients are the same whatever the base; only the carries
+        // differ: add each into the product, carrying the excess in k, which
+        // is kept in base 2^32 like the coefficients
+        std::vector<uint32_t> c1, c2, c3;
+        ntt_coefficients(c1, c2, c3, a, a, true);
+        uint64_t k0 = 0, k1 = 0, k2 = 0;
+        for (int i = 0; i < 2 * n - 1; ++i) {
+            const uint64_t w0 = k0 + c1[i];
+            const uint64_t w1 = k1 + c2[i] + (w0 >> 32);
+            const uint64_t w2 = k2 + c3[i] + (w1 >> 32);
+
+            // p[i] <- w mod 10^9, k <- w / 10^9, one 32-bit part at a time
+            uint64_t r = w2;
+            k2 = r / dec_base;
+            r = ((r % dec_base) << 32) + (w1 & 0xFFFFFFFF);
+            k1 = r / dec_base;
+            r = ((r % dec_base) << 32) + (w0 & 0xFFFFFFFF);
+            k0 = r / dec_base;
+            p[i] = static_cast<num_frag_t>(r % dec_base);
+        }
+        p[2 * n - 1] = static_cast<num_frag_t>(k0);
+    }
+    else
+        throw std::runtime_error("dec_sqr() unsupported input");
+
+    normalise(p);
+    square.swap(p);
+}
+
+
+// num <- 2 * num; num is in base 10^9
+void dec_double(num_vec_t & num)
+{
+    num_frag_t k = 0;
+    for (num_vec_t::size_type i = 0; i < num.size(); ++i) {
+        const num_frag_t t = 2 * num[i] + k;
+        k = t >= dec_base;
+        num[i] = k ? t - dec_base : t;
+    }
+    if (k)
+        num.push_back(k);
+}
+
+
+// return a decimal string representation of (2^n)-1 for the given 'n',
+// found without converting from binary; requires n > 0
+std::string prime_str_direct(int n)
+{
+    // 2^n by repeated squaring, from the most significant bit of n down,
+    // doubling the power for each bit that is set
+    num_vec_t p(1, 1);
+    int bit = 0;
+    while (n >> bit > 1)
+        ++bit;
+    for (; bit >= 0; --bit) {
+        dec_sqr(p, p);
+        if (n >> bit & 1)
+            dec_double(p);
+    }
+    --p[0]; // 2^n is not a multiple of 10, so there is no borrow
+
+    // every fragment but the most significant is 9 digits
+    int top_digits = 0;
+    for (num_frag_t x = p.back(); x; x /= 10)
+        ++top_digits;
+    std::string result(top_digits + 9 * (p.size() - 1), '0');
+    char * last = &result[0] + result.size();
+    for (num_vec_t::size_type i = 0; i < p.size(); ++i) {
+        num_frag_t x = p[i];
+        for (int j = i + 1 < p.size() ? 9 : top_digits; j--; x /= 10)
+            *--last = static_cast<char>(x % 10) + '0';
+    }
+    return result;
+}
+
+
+
 #ifndef PRIME_UNDER_TEST
 
 int main()
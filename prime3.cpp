@@ -7,6 +7,9 @@
     Compiled under OS X with g++ 4.2
         g++ -O3 prime3.cpp -lmpir -o prime3
 
+        # using OpenMP to convert the parts of the number concurrently
+        g++ -O3 -fopenmp prime3.cpp -lmpir -o prime3
+
     Compiled under Windows with VC++ 2010
         cl /nologo /EHs /O2 /I C:\mpir-2.6.0\lib\Win32\Release prime3.cpp
             /Feprime3.exe /link C:\mpir-2.6.0\lib\Win32\Release\mpir.lib
@@ -128,12 +131,15 @@ void div(num_vec_t & quotient, num_vec_t & remainder,
 }
 
 
-// return decimal representation of given 'num' zero padded to 'width'
-std::string to_string_fixed_width(
+// write decimal representation of given 'num' zero padded to 'width' to
+// first[0..width); num must have no more than width digits
+void to_string_fixed_width(
     num_vec_t num, // pass-by-value because algorithm is destructive
-    int width) // result will be at least this wide, zero filled if necessary
+    char * first,
+    int width)
 {
-    std::vector<char> result;
+    // the digits are found least significant first, so fill in from the right
+    char * last = first + width;
     // keep dividing num by 1,000,000,000 until it is 0; the remainder of each
     // division is the next least significant 9 decimal digits in the result
     while (!num.empty()) {
@@ -162,20 +168,16 @@ std::string to_string_fixed_width(
         num.resize(i);
         // extract the next 9 digits from the remainder
         for (int j = 0; j < 9; ++j) {
-            result.push_back(static_cast<char>(remainder % 10) + '0');
+            *--last = static_cast<char>(remainder % 10) + '0';
             remainder /= 10;
             if (remainder == 0 && num.empty())
-                break; // don't append superfluous zeros; e.g. 000000012 => 12
+                break; // don't write superfluous zeros; e.g. 000000012 => 12
         }
     }
 
     // add any necessary leading zeros to make the result the required width
-    width -= static_cast<int>(result.size());
-    while (width-- > 0)
-        result.push_back('0');
-
-    // the least-significant decimal digit is first so return result reversed
-    return std::string(result.rbegin(), result.rend());
+    while (last != first)
+        *--last = '0';
 }
 
 
@@ -213,17 +215,24 @@ pot_vec_t powers_of_ten(int s)
 }
 
 
-// return given 'num' as a decimal string
-std::string to_string_helper(
+// parts of numbers with at least this many bits are converted as OpenMP tasks
+// by to_string_helper(); smaller ones are not worth a task
+const int task_threshold = 1 << 16;
+
+
+// write given 'num' in decimal to first[0..width), zero filled on the left;
+// num must have no more than width digits
+void to_string_helper(
     const num_vec_t & num,
     pot_vec_t::const_reverse_iterator p,
     const pot_vec_t::const_reverse_iterator p_end,
+    char * first,
     int width)
 {
     if (p == p_end || num_bits(num) <= p->bit_count) {
         // don't need to break number into smaller pieces; it's small
         // enough to use our O(n^2) algorithm directly
-        return to_string_fixed_width(num, width);
+        to_string_fixed_width(num, first, width);
     }
     else {
         // num is too big to convert directly; break it up first
@@ -236,28 +245,66 @@ std::string to_string_helper(
         while (num_bits(quotient) > p->bit_count)
             div(quotient, parts[count++], quotient, p->n);
 
-        // then do same again for each part, collecting results into one string
-        std::string result(to_string_helper(quotient, p + 1, p_end, p->power));
-        while (count)
-            result += to_string_helper(parts[--count], p + 1, p_end, p->power);
-
-        return result;
+        // then do same again for each part, straight into its place: parts[i]
+        // is digits i * p->power to (i + 1) * p->power counting from the right
+        // and the quotient is the rest; the parts are independent so when
+        // compiled with OpenMP the big ones are converted concurrently
+        const int power = p->power;
+        for (int i = 0; i <= count; ++i) {
+#if defined(_OPENMP)
+#pragma omp task shared(parts, quotient) if (p->bit_count >= task_threshold)
+#endif
+            if (i < count)
+                to_string_helper(parts[i], p + 1, p_end, first + width - (i + 1) * power, power);
+            else
+                to_string_helper(quotient, p + 1, p_end, first, width - count * power);
+        }
+#if defined(_OPENMP)
+#pragma omp taskwait
+#endif
     }
 }
 
 
-// return given 'num' as a decimal string
-std::string to_string(const num_vec_t & num)
+// return the most decimal digits 'num' can have, from its number of bits
+// times log10(2); this is exact for (2^n)-1, as 2^n is not a power of ten
+int max_decimal_digits(const num_vec_t & num)
+{
+    return static_cast<int>(num_bits(num) * 0.30102999566398120) + 1;
+}
+
+
+// write given 'num' in decimal to first[0..width), zero filled on the left;
+// num must have no more than width digits, see max_decimal_digits()
+void to_decimal(const num_vec_t & num, char * first, int width)
 {
     // construct a table of powers of 10 appropriate to the size of the given
     // number and use it convert the number to decimal
     const pot_vec_t powers(powers_of_ten(num_bits(num) / 2));
-    std::string result(to_string_helper(num, powers.rbegin(), powers.rend(), 0));
+#if defined(_OPENMP)
+#pragma omp parallel
+#pragma omp single
+#endif
+    to_string_helper(num, powers.rbegin(), powers.rend(), first, width);
+}
+
+
+// return given 'num' as a decimal string
+std::string to_string(const num_vec_t & num)
+{
+    // each digit is written once, in place; only if max_decimal_digits() is
+    // one too many is the result moved to remove the leading zero
+    std::string result(max_decimal_digits(num), '0');
+    to_decimal(num, &result[0], static_cast<int>(result.size()));
 
     // remove all leading zeros from the result and return it,
     // or return "0" if the result was nothing but zeros
-    result.erase(0, result.find_first_not_of('0'));
-    return result.empty() ? std::string("0") : result;
+    const std::string::size_type i = result.find_first_not_of('0');
+    if (i == std::string::npos)
+        return std::string("0");
+    if (i)
+        result.erase(0, i);
+    return result;
 }
 
 
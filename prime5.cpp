@@ -21,16 +21,19 @@
 #include <vector>
 #include <stdexcept>
 #include <stdint.h>
+#include <cmath>
 #include <mpir.h>
 
 #if defined(_OPENMP)
 # include "extra/mpir/mpn_get_str_omp.c"
 # include "extra/mpir/mpf_get_str.c"
 # include "extra/mpir/mpz_get_str.c"
+# include "extra/mpir/mpz_out_str.c"
 #else
 # include "extra/mpir/mpn_get_str_thr.c"
 # include "extra/mpir/mpf_get_str.c"
 # include "extra/mpir/mpz_get_str.c"
+# include "extra/mpir/mpz_out_str.c"
 #endif
 
 // our arbitrary length unsigned number will be represented by a vector of
@@ -60,22 +63,170 @@ std::string to_string(const num_vec_t & num)
     const size_t buf_len = static_cast<size_t>(num.size() * GMP_LIMB_BITS * 0.30103) + 3;
     std::vector<unsigned char> buf(buf_len);
 
-    size_t len = mpn_get_str(&buf[0], 10, &n[0], num.size());
+    // mpn_get_str_text() writes the digits as '0'-'9' straight away
+    size_t len = mpn_get_str_text(&buf[0], 10, &n[0], num.size(), "0123456789");
 
     // skip any leading zeros
     unsigned char * start = &buf[0];
-    while (len && *start == 0) {
+    while (len && *start == '0') {
         --len;
         ++start;
     }
-    // convert 0-9 -> '0'-'9'
-    for (size_t i = 0; i < len; ++i)
-        start[i] += '0'; // (C++ standard guarantees '0'..'9' are consecutive)
 
     return len ? std::string(start, start + len) : std::string("0");
 }
 
 
+// return the number given by decimal string 's'; mpn_set_str() converts the
+// halves of s at the same time and combines them with parallel multiplies
+num_vec_t from_string(const std::string & s)
+{
+    std::vector<unsigned char> digits(s.size());
+    for (std::string::size_type i = 0; i < s.size(); ++i)
+        digits[i] = s[i] - '0';
+
+    // value < 10^size < 2^(GMP_LIMB_BITS * ceil(size / chars per limb))
+    num_vec_t num(s.size() / MP_BASES_CHARS_PER_LIMB_10 + 2);
+    const mp_size_t len = mpn_set_str(&num[0], &digits[0], digits.size(), 10);
+    num.resize(len);
+    return num;
+}
+
+
+// z <- num; z must have been initialised
+void to_mpz(mpz_t z, const num_vec_t & num)
+{
+    mpz_import(z, num.size(), -1, sizeof(num_frag_t), 0, 0, &num[0]);
+}
+
+
+// return the number of decimal digits in given 'num', without converting it
+size_t num_digits(const num_vec_t & num)
+{
+    mpz_t z, t;
+    mpz_init(z);
+    to_mpz(z, num);
+    if (mpz_sgn(z) == 0) {
+        mpz_clear(z);
+        return 1;
+    }
+
+    // num has floor(log10(num)) + 1 digits; log10(num) from the top bits of
+    // num in a double is within about 1e-7, so this is exact unless
+    // log10(num) is very close to a whole number, when 10^k is worked out
+    // and compared
+    long exp;
+    const double d = mpz_get_d_2exp(&exp, z); // num = d * 2^exp, 0.5 <= d < 1
+    const double l = std::log10(d) + exp * 0.30102999566398119521;
+    const double k = std::floor(l + 0.5);
+    size_t digits;
+    if (std::fabs(l - k) > 1e-6)
+        digits = static_cast<size_t>(std::floor(l)) + 1;
+    else {
+        mpz_init(t);
+        mpz_ui_pow_ui(t, 10, static_cast<unsigned long>(k));
+        digits = static_cast<size_t>(k) + (mpz_cmp(z, t) >= 0 ? 1 : 0);
+        mpz_clear(t);
+    }
+    mpz_clear(z);
+    return digits;
+}
+
+
+// return the last 'k' decimal digits of given 'num', or all of them if num
+// has fewer than k; found from num mod 10^k, without converting num
+std::string last_digits(const num_vec_t & num, int k)
+{
+    mpz_t z, t;
+    mpz_init(z);
+    mpz_init(t);
+    to_mpz(z, num);
+    mpz_ui_pow_ui(t, 10, k);
+
+    std::string result;
+    if (mpz_cmp(z, t) < 0)
+        result = to_string(num);
+    else {
+        mpz_tdiv_r(z, z, t);
+        std::vector<char> buf(k + 2);
+        mpz_get_str(&buf[0], 10, z);
+        result.assign(&buf[0]);
+        result.insert(0, k - result.size(), '0');
+    }
+    mpz_clear(t);
+    mpz_clear(z);
+    return result;
+}
+
+
+// return the first 'k' decimal digits of given 'num', or all of them if num
+// has fewer than k; found from floor(num / 10^(d - k)) for d digits, which
+// is computed from only the top bits of num and a floating-point 10^(d - k)
+// of a few more bits than the result, without converting num
+std::string first_digits(const num_vec_t & num, int k)
+{
+    const size_t d = num_digits(num);
+    if (d <= static_cast<size_t>(k))
+        return to_string(num);
+    const unsigned long e = static_cast<unsigned long>(d - k);
+
+    // the quotient has about 3.33 * k bits; keep 128 more bits of num to tell
+    // it apart from the nearest whole numbers, and work with 64 more again
+    // to cover the rounding errors in 10^e and the division
+    const unsigned long prec = static_cast<unsigned long>(k * 3.33) + 128;
+    mpz_t z, q;
+    mpf_t x, p;
+    mpz_init(z);
+    mpz_init(q);
+    mpf_init2(x, prec + 64);
+    mpf_init2(p, prec + 64);
+    to_mpz(z, num);
+
+    // x <- the top prec bits of num, over 10^e
+    const size_t bits = mpz_sizeinbase(z, 2);
+    const unsigned long shift = bits > prec ? static_cast<unsigned long>(bits - prec) : 0;
+    mpz_tdiv_q_2exp(q, z, shift);
+    mpf_set_z(x, q);
+    mpf_mul_2exp(x, x, shift);
+    mpf_set_ui(p, 10);
+    mpf_pow_ui(p, p, e);
+    mpf_div(x, x, p);
+
+    // the answer is floor(x) unless x is within 2^-32 of a whole number,
+    // when num / 10^e is worked out exactly
+    mpz_set_f(q, x);
+    mpf_set_z(p, q);
+    mpf_sub(p, x, p); // the fractional part of x
+    if (mpf_cmp_d(p, 1.0 / 4294967296.0) < 0 || mpf_cmp_d(p, 1.0 - 1.0 / 4294967296.0) > 0) {
+        mpz_ui_pow_ui(q, 10, e);
+        mpz_tdiv_q(q, z, q);
+    }
+
+    std::vector<char> buf(k + 2);
+    mpz_get_str(&buf[0], 10, q);
+    mpf_clear(p);
+    mpf_clear(x);
+    mpz_clear(q);
+    mpz_clear(z);
+    return std::string(&buf[0]);
+}
+
+
+// return 'len' decimal digits of given 'num' from position 'start' counted
+// from the right, zero padded on the left; mpn_get_str_window() divides only
+// the parts of num covering them
+std::string digit_window(const num_vec_t & num, size_t start, size_t len)
+{
+    num_vec_t n(num); // make a copy because mpn_get_str_window() destroys it
+    n.push_back(0);
+    std::string result(len, '0');
+    if (len)
+        mpn_get_str_window(reinterpret_cast<unsigned char *>(&result[0]), 10,
+            &n[0], num.size(), start, len, "0123456789");
+    return result;
+}
+
+
 // set given 'p' to the value of (2^n)-1 for given 'n'; requires n > 0
 void make_prime(int n, num_vec_t & p)
 {
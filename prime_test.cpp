@@ -12,6 +12,18 @@
         g++ -O3 -DTEST3 prime_test.cpp -l mpir -o prime3_test
         g++ -O3 -DTEST4 prime_test.cpp -l mpir -o prime4_test
 
+        # prime2.cpp and prime3.cpp: using OpenMP to convert parts concurrently
+        g++ -O3 -DTEST2 -fopenmp prime_test.cpp -o prime2_test
+        g++ -O3 -DTEST3 -fopenmp prime_test.cpp -l mpir -o prime3_test
+
+        # prime2.cpp: computing (2^n)-1 in decimal with prime_str_direct()
+        g++ -O3 -DTEST2 -DDIRECT prime_test.cpp -o prime2_direct_test
+
+        # GMP: checking the Mersenne primes' digit counts, first and last
+        # digits with num_digits(), first_digits() and last_digits() only
+        g++ -O3 -DTEST6 -DDIGITS -pthread prime_test.cpp -I/usr/local/include
+            -L/usr/local/lib -l gmp -o prime6_digits_test -Wno-attributes
+
         # MPIR: using OpenMP for parallel recursion in mpn_get_str
         # OS X's native compiler lacks OpenMP support, use pthread instead
         g++ -O3 -DTEST5 -fopenmp prime_test.cpp -I/usr/local/include
@@ -147,12 +159,71 @@ void test_num_bits()
 }
 
 
+#if defined(TEST2)
+typedef void (*div_fn_t)(num_vec_t & quotient, num_vec_t & remainder,
+    const num_vec_t & u, const num_vec_t & v);
+
+// check given 'divide' gives q and r with q * v + r == u and r < v for given
+// 'u' and 'v'
+void test_div(div_fn_t divide, const char * name,
+    const num_vec_t & u, const num_vec_t & v)
+{
+    num_vec_t q, r, check;
+    divide(q, r, u, v);
+    mul(check, q, v);
+    add(check, check, r);
+    if (compare(check, u) != 0 || compare(r, v) >= 0) {
+        ++g_failure_count;
+        std::cout
+            << "test_div failed: " << name << "() for u of " << u.size()
+            << " fragments and v of " << v.size() << " fragments\n";
+    }
+}
+#endif
+
+// check div() for a range of sizes either side of where it changes algorithm,
+// with divisors that do and don't have their most significant bit set; and
+// div_newton() directly, as div() only uses it beyond newton_threshold, for
+// those where the quotient is shorter than the divisor
+void test_div()
+{
+#if defined(TEST2)
+    const int sizes[] = { 1, 2, 3, 59, 60, 61, 64, 127, 250, 500 };
+    const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    uint32_t x = 12345; // simple linear congruential pseudo-random numbers
+    for (int i = 0; i < num_sizes; ++i) {
+        for (int j = i; j < num_sizes; ++j) {
+            for (int k = 0; k < 4; ++k) {
+                num_vec_t u(sizes[j] + sizes[i] * (k % 2)), v(sizes[i]);
+                for (size_t f = 0; f < u.size(); ++f)
+                    u[f] = (k < 2) ? (x = x * 1664525 + 1013904223) : ~0u;
+                for (size_t f = 0; f < v.size(); ++f)
+                    v[f] = (x = x * 1664525 + 1013904223);
+                if (k % 2)
+                    v.back() |= 0x80000000;
+                else
+                    v.back() = (v.back() >> (x % 31)) | 1;
+                normalise(u);
+                test_div(div, "div", u, v);
+                if (u.size() >= v.size() && u.size() - v.size() < v.size())
+                    test_div(div_newton, "div_newton", u, v);
+            }
+        }
+    }
+#endif
+}
+
+
 // check decimal representation of (2^n)-1, for given 'n', matches given 'expected'
 void prime_test(int n, const char * expected)
 {
+#if defined(TEST2) && defined(DIRECT)
+    const std::string s(prime_str_direct(n));
+#else
     num_vec_t p;
     make_prime(n, p);
     const std::string s(to_string(p));
+#endif
 
     if (s != expected) {
         ++g_failure_count;
@@ -174,20 +245,34 @@ void prime_test(int n, int num_digits,
         std::cout << "Calculating 2^n-1 for n=" << n << "...\n";
     }
 
+#if (defined(TEST5) || defined(TEST6)) && defined(DIGITS)
+    // find just the digits we check, without converting the whole number
+    num_vec_t p;
+    make_prime(n, p);
+    const size_t size = ::num_digits(p);
+    const std::string start(first_digits(p, strlen(expected_start)));
+    const std::string end(last_digits(p, strlen(expected_end)));
+#else
+#if defined(TEST2) && defined(DIRECT)
+    const std::string s(prime_str_direct(n));
+#else
     num_vec_t p;
     make_prime(n, p);
     const std::string s(to_string(p));
+#endif
 
+    const size_t size = s.size();
     const size_t start_len = strlen(expected_start);
     const std::string start(start_len < s.size() ? s.substr(0, start_len) : s);
     const size_t end_len = strlen(expected_end);
     const std::string end(end_len < s.size() ? s.substr(s.size() - end_len) : s);
+#endif
 
-    if (s.size() != num_digits) {
+    if (size != num_digits) {
         ++g_failure_count;
         std::cout
             << "test failed: for n " << n
-            << " got " << s.size()
+            << " got " << size
             << " digits, expected " << num_digits
             << '\n';
     }
@@ -207,6 +292,15 @@ void prime_test(int n, int num_digits,
             << " end, expected " << expected_end
             << '\n';
     }
+#if (defined(TEST5) || defined(TEST6)) && !defined(DIGITS)
+    // and back: mpn_set_str() must give (2^n)-1 again
+    if (from_string(s) != p) {
+        ++g_failure_count;
+        std::cout
+            << "test failed: for n " << n
+            << " from_string() did not give back (2^n)-1\n";
+    }
+#endif
 }
 
 
@@ -255,11 +349,8 @@ void test_prime_calculation()
     prime_test(  216091,    65050, "746093103", "815528447");
     prime_test(  756839,   227832, "174135906", "544677887");
     prime_test(  859433,   258716, "129498125", "500142591");
-#endif
-
-#if defined(TEST3) || defined(TEST4) || defined(TEST5) || defined(TEST6)
-    // these take too long for prime0.cpp, prime1.cpp and prime2.cpp
-    // (prime3.cpp and prime4.cpp can do them in 20 minutes or so)
+    // (prime3.cpp and prime4.cpp can do the rest in 20 minutes or so,
+    // prime2.cpp in under 10)
     prime_test( 1257787,   378632, "412245773", "089366527");
     prime_test( 1398269,   420921, "814717564", "451315711");
     prime_test( 2976221,   895932, "623340076", "729201151");
@@ -479,13 +570,107 @@ void test_zeros_binary_to_decimal_conversion()
 }
 
 
+#if defined(TEST5) || defined(TEST6)
+// check num_digits(), first_digits(), last_digits(), digit_window() and
+// mpz_out_sum() agree with to_string() for given 'num'
+void test_digits(const num_vec_t & num)
+{
+    const std::string s(to_string(num));
+    const int ks[] = { 1, 9, 30 };
+    for (int i = 0; i < 3; ++i) {
+        const size_t k = ks[i];
+        const std::string start(k < s.size() ? s.substr(0, k) : s);
+        const std::string end(k < s.size() ? s.substr(s.size() - k) : s);
+        if (num_digits(num) != s.size()
+            || first_digits(num, k) != start || last_digits(num, k) != end) {
+            ++g_failure_count;
+            std::cout
+                << "test_digits failed: for " << start << "..." << end
+                << " of " << s.size() << " digits, k " << k << '\n';
+        }
+
+        // windows at the right, middle and left end, and past the left end
+        const size_t offsets[] = { 0, s.size() / 2, s.size() - 1, s.size() + 3 };
+        for (int j = 0; j < 4; ++j) {
+            std::string expected(k, '0');
+            for (size_t d = 0; d < k; ++d) {
+                const size_t pos = offsets[j] + k - 1 - d;
+                if (pos < s.size())
+                    expected[d] = s[s.size() - 1 - pos];
+            }
+            if (digit_window(num, offsets[j], k) != expected) {
+                ++g_failure_count;
+                std::cout
+                    << "test_digits failed: digit_window(" << offsets[j]
+                    << ", " << k << ") of " << s.size() << " digits\n";
+            }
+        }
+    }
+    // mpz_out_sum() folds the digits into a sum and a CRC as they are
+    // converted, and checks the sum against num mod 9
+    unsigned long expected_sum = 0, sum, crc;
+    for (size_t i = 0; i < s.size(); ++i)
+        expected_sum += s[i] - '0';
+    mpz_t z;
+    mpz_init(z);
+    to_mpz(z, num);
+    if (mpz_out_sum(10, z, &sum, &crc) != s.size() || sum != expected_sum) {
+        ++g_failure_count;
+        std::cout
+            << "test_digits failed: mpz_out_sum() of " << s.size()
+            << " digits gave sum " << sum << ", expected " << expected_sum << '\n';
+    }
+    mpz_clear(z);
+}
+#endif
+
+// check num_digits(), first_digits(), last_digits() and digit_window()
+// either side of powers of ten, where the number of digits changes and the
+// first digits are closest to whole numbers, and for some (2^n)-1
+void test_digits()
+{
+#if defined(TEST5) || defined(TEST6)
+    const int zeros[] = { 0, 1, 9, 19, 20, 100, 3210, 100000 };
+    for (int i = 0; i < 8; ++i) {
+        num_vec_t ten, n;
+        ten.push_back(10);
+        n.push_back(1);
+        for (int j = 0; j < zeros[i]; ++j)
+            n *= ten;
+        test_digits(n);
+
+        num_vec_t m(n);
+        if (zeros[i]) {
+            mpn_sub_1(&m[0], &m[0], m.size(), 1);
+            normalise(m);
+            test_digits(m);
+        }
+        m = n;
+        m.push_back(0);
+        mpn_add_1(&m[0], &m[0], m.size(), 1);
+        normalise(m);
+        test_digits(m);
+    }
+
+    const int exponents[] = { 1, 64, 521, 4423, 86243, 859433 };
+    for (int i = 0; i < 6; ++i) {
+        num_vec_t p;
+        make_prime(exponents[i], p);
+        test_digits(p);
+    }
+#endif
+}
+
+
 int main()
 {
     test_count_leading_zeros();
     test_num_bits();
+    test_div();
     test_basic_binary_to_decimal_conversion();
     test_basic_make_prime_calculation();
     test_zeros_binary_to_decimal_conversion();
+    test_digits();
     test_prime_calculation();
 
     std::cout << "total failures " << g_failure_count << '\n';